@@ -4,9 +4,15 @@
 #include <string> // std::stod()
 #include <vector>
 
+#include "arena.h"
+#include "constants.h"
+#include "environment.h"
+#include "feedback.h"
+#include "heap.h"
 #include "token.h"
 #include "ASTVisitor.h"
 #include "nobject.h"
+#include "value.h"
 
 /**
  * Abstract Syntax Tree Classes
@@ -14,13 +20,19 @@
 
 namespace napkin {
 
+class ClosureCode;
+class CompiledFunction;
+class JitCode;
+struct LoopInvariant;
+
 /**
  * Base class for statements.
  */
 class Stmt {
 public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) = 0;
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) = 0;
+  virtual Value accept(ASTVisitor<Value> *visitor) = 0;
+  virtual void accept(ASTVisitor<void> *visitor) = 0;
 };
 
 /**
@@ -33,9 +45,12 @@ public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitExprStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitExprStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitExprStmt(this);
+  }
 
   Expr *expr; // The expression that forms the statment
 };
@@ -49,9 +64,12 @@ public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitOutputStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitOutputStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitOutputStmt(this);
+  }
 
   Expr *expr; // The expression to be output
 };
@@ -61,15 +79,24 @@ public:
  */
 class BlockStmt : public Stmt {
 public:
-  BlockStmt(std::vector<Stmt *> t_stmts) : stmts(t_stmts){};
+  BlockStmt(std::vector<Stmt *> t_stmts)
+      : stmts(t_stmts), needsFrame(true), slotCount(0){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitBlockStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitBlockStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitBlockStmt(this);
+  }
 
   std::vector<Stmt *> stmts;
+  // Set by the Resolver. Blocks that bind no names and create no closures run
+  // in the enclosing frame. The body of a lambda always gets the call frame.
+  bool needsFrame;
+  // Number of local variables in the block's frame
+  unsigned long slotCount;
 };
 
 /**
@@ -83,9 +110,12 @@ public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitIfStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitIfStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitIfStmt(this);
+  }
 
   Expr *condition;
   Stmt *thenBranch;
@@ -99,16 +129,37 @@ public:
 class WhileStmt : public Stmt {
 public:
   WhileStmt(Expr *t_condition, Stmt *t_body)
-      : condition(t_condition), body(t_body) {}
+      : condition(t_condition), body(t_body), run(0) {}
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitWhileStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitWhileStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitWhileStmt(this);
+  }
 
   Expr *condition;
   Stmt *body;
+  // Operators whose value can't change while the loop runs (see
+  // InvariantAnalyzer)
+  std::vector<LoopInvariant *> invariants;
+  // Identifies the innermost run of the loop in progress, 0 if there is none
+  unsigned long run;
+};
+
+/**
+ * Value of a loop invariant operator. Computed the first time the operator is
+ * evaluated in a run of its loop and reused until the run ends.
+ */
+struct LoopInvariant {
+  LoopInvariant(WhileStmt *t_loop) : loop(t_loop), run(0){};
+
+  WhileStmt *loop;
+  // Run of the loop the value belongs to
+  unsigned long run;
+  Value value;
 };
 
 /**
@@ -121,9 +172,12 @@ public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitReturnStmt(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitReturnStmt(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitReturnStmt(this);
+  }
 
   Token keyword; // Store the "return" token for error reporting
   Expr *value; // The value to be returned
@@ -135,7 +189,23 @@ public:
 class Expr {
 public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) = 0;
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) = 0;
+  virtual Value accept(ASTVisitor<Value> *visitor) = 0;
+  virtual void accept(ASTVisitor<void> *visitor) = 0;
+};
+
+/**
+ * A variable of an enclosing function that a lambda's body refers to (see
+ * NClosure). Set by the Resolver.
+ */
+struct Capture {
+  Capture(long t_slot, unsigned long t_frameSlot)
+      : depth(0), slot(t_slot), frameSlot(t_frameSlot){};
+
+  // Address of the variable from where the lambda is created
+  unsigned long depth;
+  long slot;
+  // Slot of the call frame that holds the variable's cell during a call
+  unsigned long frameSlot;
 };
 
 /**
@@ -143,17 +213,36 @@ public:
  */
 class LambdaExpr : public Expr {
 public:
-  LambdaExpr(std::vector<Identifier *> t_parameters, BlockStmt *t_body)
-      : parameters(t_parameters), body(t_body){};
+  LambdaExpr(Token t_arrow, std::vector<Identifier *> t_parameters,
+             BlockStmt *t_body, Arena *t_arena)
+      : arrow(t_arrow), parameters(t_parameters), body(t_body),
+        arena(t_arena), function(nullptr), code(nullptr), jit(nullptr),
+        pure(false){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitLambdaExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitLambdaExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitLambdaExpr(this);
+  }
 
+  Token arrow; // Location of the lambda for allocation profiling
   std::vector<Identifier *> parameters;
   BlockStmt *body;
+  // Free variables of the body, which closures capture
+  std::vector<Capture> captures;
+  Arena *arena; // The arena that owns this node
+  // Bytecode for the body, set by the Compiler (also owned by the arena)
+  CompiledFunction *function;
+  // Body compiled by the ClosureCompiler (also owned by the arena)
+  ClosureCode *code;
+  // Native code for the body, set by the JitCompiler (also owned by the arena)
+  JitCode *jit;
+  // True if calls may be memoized (see PurityAnalyzer). Cleared when a call
+  // turns out to have side effects.
+  bool pure;
 };
 
 /**
@@ -161,16 +250,27 @@ public:
  */
 class VarDeclExpr : public Expr {
 public:
-  VarDeclExpr(Token t_name, Expr *t_value) : name(t_name), value(t_value){};
+  VarDeclExpr(Token t_name, Expr *t_value)
+      : name(t_name), value(t_value), depth(0), slot(-1), boxed(false),
+        invalidatesMemos(false){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitVarDeclExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitVarDeclExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitVarDeclExpr(this);
+  }
 
   Token name;
   Expr *value;
+  // Address of the variable (see Identifier)
+  unsigned long depth;
+  long slot;
+  bool boxed;
+  // True if pure closures may read the variable (see PurityAnalyzer)
+  bool invalidatesMemos;
 };
 
 /**
@@ -178,16 +278,28 @@ public:
  */
 class AssignExpr : public Expr {
 public:
-  AssignExpr(Token t_name, Expr *t_value) : name(t_name), value(t_value){};
+  AssignExpr(Token t_name, Expr *t_value)
+      : name(t_name), value(t_value), depth(0), slot(-1), boxed(false),
+        cache(t_name.getLexeme()), invalidatesMemos(false){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitAssignExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitAssignExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitAssignExpr(this);
+  }
 
   Token name;
   Expr *value;
+  // Address of the variable (see Identifier)
+  unsigned long depth;
+  long slot;
+  bool boxed;
+  GlobalCache cache;
+  // True if pure closures may read the variable (see PurityAnalyzer)
+  bool invalidatesMemos;
 };
 
 /**
@@ -196,17 +308,28 @@ public:
 class BinaryExpr : public Expr {
 public:
   BinaryExpr(Token t_operator, Expr *t_left, Expr *t_right)
-      : _operator(t_operator), left(t_left), right(t_right){};
+      : _operator(t_operator), left(t_left), right(t_right), escapes(true),
+        invariant(nullptr){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitBinaryExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitBinaryExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitBinaryExpr(this);
+  }
 
   Token _operator;
   Expr *left;
   Expr *right;
+  // False if the result can't outlive the closure call that computes it
+  // (see EscapeAnalyzer)
+  bool escapes;
+  // Operand types seen by the interpreter
+  TypeFeedback feedback;
+  // Set if the operator is loop invariant, nullptr otherwise
+  LoopInvariant *invariant;
 };
 
 /**
@@ -218,9 +341,12 @@ public:
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitGrouping(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitGrouping(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitGrouping(this);
+  }
 
   Expr *contents;
 };
@@ -231,16 +357,26 @@ public:
 class UnaryExpr : public Expr {
 public:
   UnaryExpr(Token t_operator, Expr *t_right)
-      : _operator(t_operator), right(t_right){};
+      : _operator(t_operator), right(t_right), escapes(true),
+        invariant(nullptr){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitUnaryExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitUnaryExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitUnaryExpr(this);
+  }
 
   Token _operator;
   Expr *right;
+  // Same as BinaryExpr::escapes
+  bool escapes;
+  // Same as BinaryExpr::feedback
+  TypeFeedback feedback;
+  // Same as BinaryExpr::invariant
+  LoopInvariant *invariant;
 };
 
 /**
@@ -249,17 +385,24 @@ public:
 class CallExpr : public Expr {
 public:
   CallExpr(Expr *t_callee, Token t_paren, std::vector<Expr *> t_arguments)
-      : callee(t_callee), paren(t_paren), arguments(t_arguments){};
+      : callee(t_callee), paren(t_paren), arguments(t_arguments),
+        tail(false){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitCallExpr(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitCallExpr(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitCallExpr(this);
+  }
 
   Expr *callee;
   Token paren; // to report location of function call if runtime error
   std::vector<Expr *> arguments;
+  // True if the call's value is the value of the lambda it is in (set by the
+  // Resolver), so the lambda's callsite can make the call instead
+  bool tail;
 };
 
 /**
@@ -267,15 +410,30 @@ public:
  */
 class Identifier : public Expr {
 public:
-  Identifier(Token t_token) : token(t_token){};
+  Identifier(Token t_token)
+      : token(t_token), depth(0), slot(-1), boxed(false),
+        cache(t_token.getLexeme()){};
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitIdentifier(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitIdentifier(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitIdentifier(this);
+  }
 
   Token token;
+  // Set by the Resolver: the number of frames to walk out from the current
+  // one and the variable's slot in that frame. Names that aren't local to any
+  // enclosing block or function have slot -1 and are looked up by name in the
+  // global environment.
+  unsigned long depth;
+  long slot;
+  // True if closures capture the variable, whose slot then holds a Cell
+  bool boxed;
+  // Where the global was last found (for slot -1)
+  GlobalCache cache;
 };
 
 /**
@@ -285,15 +443,24 @@ class RealNumber : public Expr {
 public:
   RealNumber(Token t_token) : token(t_token) {
     value = std::stod(token.getLexeme());
+    constant = Value(value);
+  };
+  // A constant folded from an expression (see ConstantFolder)
+  RealNumber(Token t_token, double t_value) : value(t_value), token(t_token) {
+    constant = Value(value);
   };
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitRealNumber(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitRealNumber(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitRealNumber(this);
+  }
 
   double value;
+  Value constant;
 
 private:
   Token token;
@@ -301,20 +468,40 @@ private:
 
 /**
  * Imaginary number literals.
+ * Complex constants folded from an expression (see ConstantFolder) also have
+ * a real part.
  */
 class ImaginaryNumber : public Expr {
 public:
-  ImaginaryNumber(Token t_token) : token(t_token) {
+  ImaginaryNumber(Token t_token) : real(0), token(t_token) {
     value = std::stod(token.getLexeme());
+    NComplexNumber *number = new NComplexNumber(0, value);
+    heap()->pin(number);
+    constant = Value(number);
   };
+  ImaginaryNumber(Token t_token, double t_real, double t_value)
+      : value(t_value), real(t_real), token(t_token) {
+    NComplexNumber *number = new NComplexNumber(real, value);
+    heap()->pin(number);
+    constant = Value(number);
+  };
+  ~ImaginaryNumber() {
+    heap()->unpin(constant.asObject());
+  }
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitImaginaryNumber(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitImaginaryNumber(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitImaginaryNumber(this);
+  }
 
   double value;
+  double real;
+  // Shared by every evaluation of the literal, pinned while the node exists
+  Value constant;
 
 private:
   Token token;
@@ -325,15 +512,27 @@ private:
  */
 class String : public Expr {
 public:
-  String(Token t_token) : token(t_token){};
+  String(Token t_token) : token(t_token) {
+    NString *string = new NString(token.getLexeme());
+    heap()->pin(string);
+    constant = Value(string);
+  };
+  ~String() {
+    heap()->unpin(constant.asObject());
+  }
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitString(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitString(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitString(this);
+  }
 
   Token token;
+  // Shared by every evaluation of the literal, pinned while the node exists
+  Value constant;
 };
 
 /**
@@ -341,15 +540,25 @@ public:
  */
 class Boolean : public Expr {
 public:
-  Boolean(Token t_token) : token(t_token){};
+  Boolean(Token t_token) : token(t_token) {
+    constant = Value::boolean(token.getTokenType() == TOKEN_TRUE);
+  };
+  // A constant folded from an expression (see ConstantFolder)
+  Boolean(Token t_token, bool t_value) : token(t_token) {
+    constant = Value::boolean(t_value);
+  };
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitBoolean(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitBoolean(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitBoolean(this);
+  }
 
   Token token;
+  Value constant;
 };
 
 /**
@@ -357,15 +566,32 @@ public:
  */
 class KeywordConstant : public Expr {
 public:
-  KeywordConstant(Token t_token) : token(t_token){};
+  KeywordConstant(Token t_token) : token(t_token) {
+    // Left undefined for keywords without a value
+    constant = Value::undefined();
+    switch (token.getTokenType()) {
+    case TOKEN_PI:
+      constant = Value(pi);
+      break;
+    case TOKEN_EULER:
+      constant = Value(euler);
+      break;
+    default:
+      break;
+    }
+  };
   virtual std::string accept(ASTVisitor<std::string> *visitor) {
     return visitor->visitKeywordConstant(this);
   }
-  virtual NObject *accept(ASTVisitor<NObject *> *visitor) {
+  virtual Value accept(ASTVisitor<Value> *visitor) {
     return visitor->visitKeywordConstant(this);
   }
+  virtual void accept(ASTVisitor<void> *visitor) {
+    visitor->visitKeywordConstant(this);
+  }
 
   Token token;
+  Value constant;
 };
 
 } // namespace napkin
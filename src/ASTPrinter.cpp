@@ -104,6 +104,9 @@ std::string ASTPrinter::visitRealNumber(RealNumber *expr) {
 
 std::string ASTPrinter::visitImaginaryNumber(ImaginaryNumber *expr) {
   std::string value = std::to_string(expr->value);
+  if (expr->real != 0) {
+    return "(" + std::to_string(expr->real) + " + j" + value + ")";
+  }
   return "j" + value;
 }
 
@@ -112,7 +115,7 @@ std::string ASTPrinter::visitString(String *expr) {
 }
 
 std::string ASTPrinter::visitBoolean(Boolean *expr) {
-  return expr->token.getLexeme();
+  return expr->constant.asBoolean() ? "true" : "false";
 }
 
 std::string ASTPrinter::visitKeywordConstant(KeywordConstant *expr) {
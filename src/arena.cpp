@@ -0,0 +1,96 @@
+#include "arena.h"
+
+#include <cstdlib>
+
+namespace napkin {
+
+// Size of a regular block (large allocations get a block of their own)
+static const std::size_t BLOCK_SIZE = 32 * 1024;
+
+Arena::Arena() {
+  blocks = nullptr;
+  current = nullptr;
+  end = nullptr;
+  finalizers = nullptr;
+  bytesUsed = 0;
+  references = 0;
+}
+
+/**
+ * Destroys every object in the arena and frees all of its blocks at once.
+ */
+Arena::~Arena() {
+  for (Finalizer *finalizer = finalizers; finalizer != nullptr;
+       finalizer = finalizer->next) {
+    finalizer->function(finalizer->object);
+  }
+  while (blocks != nullptr) {
+    Block *next = blocks->next;
+    std::free(blocks);
+    blocks = next;
+  }
+}
+
+/**
+ * Returns uninitialized memory from the current block, starting a new block if
+ * there isn't enough room left.
+ */
+void *Arena::allocate(std::size_t size, std::size_t alignment) {
+  std::size_t padding = (alignment - (std::size_t)current % alignment) %
+                        alignment;
+  if (current == nullptr || padding + size > (std::size_t)(end - current)) {
+    // The data of a block starts right after its (suitably aligned) header
+    std::size_t headerSize =
+        (sizeof(Block) + alignof(std::max_align_t) - 1) &
+        ~(alignof(std::max_align_t) - 1);
+    std::size_t blockSize = BLOCK_SIZE;
+    if (size + alignment > blockSize) {
+      blockSize = size + alignment;
+    }
+    Block *block = (Block *)std::malloc(headerSize + blockSize);
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    block->next = blocks;
+    block->size = blockSize;
+    blocks = block;
+    current = (char *)block + headerSize;
+    end = current + blockSize;
+    padding = (alignment - (std::size_t)current % alignment) % alignment;
+  }
+
+  void *memory = current + padding;
+  current += padding + size;
+  bytesUsed += padding + size;
+  return memory;
+}
+
+void Arena::retain() {
+  references++;
+}
+
+void Arena::release() {
+  references--;
+}
+
+/**
+ * Returns true if closures created from this arena's code may still be called.
+ */
+bool Arena::isRetained() {
+  return references != 0;
+}
+
+std::size_t Arena::getBytesUsed() {
+  return bytesUsed;
+}
+
+void Arena::addFinalizer(void (*function)(void *), void *object) {
+  Finalizer *finalizer =
+      (Finalizer *)allocate(sizeof(Finalizer), alignof(Finalizer));
+  finalizer->function = function;
+  finalizer->object = object;
+  finalizer->next = finalizers;
+  finalizers = finalizer;
+}
+
+} // namespace napkin
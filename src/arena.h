@@ -0,0 +1,86 @@
+#ifndef NAPKIN_ARENA_H_
+#define NAPKIN_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace napkin {
+
+/**
+ * Bump allocator that owns every node of one parsed compilation unit.
+ * Nodes are placed one after another in large blocks and are all destroyed
+ * together when the arena is destroyed.
+ *
+ * Closures refer to the LambdaExpr they were created from, so an arena keeps
+ * count of the closures created from its code. A unit must not be freed while
+ * that count is non-zero.
+ */
+class Arena {
+public:
+  Arena();
+  ~Arena();
+
+  // Constructs a T inside the arena
+  template <class T, class... Args> T *make(Args &&... args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      addFinalizer(&destroy<T>, object);
+    }
+    return object;
+  }
+
+  void *allocate(std::size_t size, std::size_t alignment);
+
+  // Closures created from code in this arena
+  void retain();
+  void release();
+  bool isRetained();
+
+  std::size_t getBytesUsed();
+
+private:
+  /**
+   * A chunk of memory that nodes are bump allocated from.
+   */
+  struct Block {
+    Block *next;
+    std::size_t size;
+  };
+
+  /**
+   * Destructor to run for a node when the arena is destroyed.
+   */
+  struct Finalizer {
+    void (*function)(void *);
+    void *object;
+    Finalizer *next;
+  };
+
+  template <class T> static void destroy(void *object) {
+    ((T *)object)->~T();
+  }
+
+  void addFinalizer(void (*function)(void *), void *object);
+
+  Block *blocks;
+  // Current position and end of the newest block
+  char *current;
+  char *end;
+
+  // Most recently added finalizer (run in reverse order of construction)
+  Finalizer *finalizers;
+
+  std::size_t bytesUsed;
+  unsigned long references;
+
+  // Arenas own their nodes and cannot be copied
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+};
+
+} // namespace napkin
+
+#endif
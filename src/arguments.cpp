@@ -0,0 +1,57 @@
+#include "arguments.h"
+
+namespace napkin {
+
+ArgumentStack::ArgumentStack() {
+  chunks.push_back({new Value[CHUNK_SIZE], CHUNK_SIZE, 0});
+  current = 0;
+}
+
+ArgumentStack::~ArgumentStack() {
+  for (unsigned long i = 0; i < chunks.size(); i++) {
+    delete[] chunks[i].values;
+  }
+}
+
+/**
+ * The values of a call are always contiguous: if they don't fit in the
+ * current chunk, they start the next one, which is made larger if needed.
+ */
+Value *ArgumentStack::push(unsigned long count) {
+  if (chunks[current].used + count > chunks[current].capacity) {
+    current++;
+    if (current == chunks.size()) {
+      unsigned long capacity = count > CHUNK_SIZE ? count : CHUNK_SIZE;
+      chunks.push_back({new Value[capacity], capacity, 0});
+    } else if (chunks[current].capacity < count) {
+      delete[] chunks[current].values;
+      chunks[current].values = new Value[count];
+      chunks[current].capacity = count;
+    }
+  }
+  Chunk &chunk = chunks[current];
+  Value *values = chunk.values + chunk.used;
+  for (unsigned long i = 0; i < count; i++) {
+    values[i] = Value();
+  }
+  chunk.used += count;
+  return values;
+}
+
+void ArgumentStack::trace(Heap *heap) {
+  for (unsigned long i = 0; i <= current; i++) {
+    for (unsigned long j = 0; j < chunks[i].used; j++) {
+      markValue(heap, chunks[i].values[j]);
+    }
+  }
+}
+
+ArgumentScope::~ArgumentScope() {
+  for (unsigned long i = chunk + 1; i <= stack.current; i++) {
+    stack.chunks[i].used = 0;
+  }
+  stack.current = chunk;
+  stack.chunks[chunk].used = used;
+}
+
+} // namespace napkin
@@ -0,0 +1,86 @@
+#ifndef NAPKIN_ARGUMENTS_H_
+#define NAPKIN_ARGUMENTS_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "value.h"
+
+namespace napkin {
+
+/**
+ * The arguments of a call: a view of values owned by the caller (usually on
+ * the interpreter's ArgumentStack, or on the VM's value stack), which stay in
+ * place until the call returns.
+ */
+class Arguments {
+public:
+  Arguments() : values(nullptr), count(0){};
+  Arguments(Value *t_values, unsigned long t_count)
+      : values(t_values), count(t_count){};
+  Arguments(std::vector<Value> &t_values)
+      : values(t_values.data()), count(t_values.size()){};
+
+  unsigned long size() const { return count; }
+  Value &operator[](unsigned long i) const { return values[i]; }
+  Value *begin() const { return values; }
+  Value *end() const { return values + count; }
+
+private:
+  Value *values;
+  unsigned long count;
+};
+
+/**
+ * Stack the interpreter evaluates the callee and arguments of its calls on.
+ * It grows a chunk at a time and chunks never move, so the Arguments of the
+ * calls that are running stay valid while more calls are made. Chunks are
+ * kept once allocated, so calls don't allocate.
+ */
+class ArgumentStack {
+public:
+  ArgumentStack();
+  ~ArgumentStack();
+
+  // Reserves count values (set to nil) on top of the stack
+  Value *push(unsigned long count);
+
+  void trace(Heap *heap);
+
+  static const unsigned long CHUNK_SIZE = 4096;
+
+private:
+  // Pops everything pushed during its lifetime
+  friend class ArgumentScope;
+
+  struct Chunk {
+    Value *values;
+    unsigned long capacity;
+    unsigned long used;
+  };
+
+  std::vector<Chunk> chunks;
+  // Chunk holding the top of the stack
+  unsigned long current;
+};
+
+/**
+ * Pops the values pushed on an ArgumentStack during its lifetime, even when
+ * an exception is thrown.
+ */
+class ArgumentScope {
+public:
+  ArgumentScope(ArgumentStack &t_stack)
+      : stack(t_stack), chunk(t_stack.current),
+        used(t_stack.chunks[t_stack.current].used){};
+  ~ArgumentScope();
+
+private:
+  ArgumentStack &stack;
+  unsigned long chunk;
+  unsigned long used;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,49 @@
+#include "budget.h"
+
+#include <limits>
+#include <string>
+
+#include "nexception.h"
+
+namespace napkin {
+
+ExecutionBudget::ExecutionBudget() {
+  steps = 0;
+  maxSteps = 0;
+  nextCheck = std::numeric_limits<unsigned long>::max();
+  hasDeadline = false;
+  timeout = 0;
+}
+
+void ExecutionBudget::setMaxSteps(unsigned long t_maxSteps) {
+  maxSteps = t_maxSteps;
+  nextCheck = steps;
+}
+
+void ExecutionBudget::setTimeout(unsigned long milliseconds) {
+  hasDeadline = milliseconds != 0;
+  timeout = milliseconds;
+  deadline = std::chrono::steady_clock::now() +
+             std::chrono::milliseconds(milliseconds);
+  nextCheck = steps;
+}
+
+void ExecutionBudget::check() {
+  if (maxSteps != 0 && steps > maxSteps) {
+    throw BudgetExceededException("step budget of " +
+                                  std::to_string(maxSteps) + " exceeded.");
+  }
+  if (hasDeadline && std::chrono::steady_clock::now() >= deadline) {
+    throw BudgetExceededException("time budget of " + std::to_string(timeout) +
+                                  " ms exceeded.");
+  }
+  nextCheck = std::numeric_limits<unsigned long>::max();
+  if (maxSteps != 0) {
+    nextCheck = maxSteps + 1;
+  }
+  if (hasDeadline && steps + CLOCK_INTERVAL < nextCheck) {
+    nextCheck = steps + CLOCK_INTERVAL;
+  }
+}
+
+} // namespace napkin
@@ -0,0 +1,52 @@
+#ifndef NAPKIN_BUDGET_H_
+#define NAPKIN_BUDGET_H_
+
+#include <chrono>
+
+namespace napkin {
+
+/**
+ * Counts the steps a run executes, and stops it with a
+ * BudgetExceededException once it exceeds a number of steps or a wall-clock
+ * deadline.
+ *
+ * The Interpreter (and the closures the ClosureCompiler makes) count a step
+ * per statement and per loop iteration, the VM one per loop iteration and
+ * per call. Counting is an increment and a comparison. The clock is only
+ * read every CLOCK_INTERVAL steps, so a deadline may be overrun by that many
+ * steps.
+ */
+class ExecutionBudget {
+public:
+  ExecutionBudget();
+
+  // Steps allowed in the whole run (0 for no limit)
+  void setMaxSteps(unsigned long t_maxSteps);
+  // Milliseconds allowed from now on (0 for no limit)
+  void setTimeout(unsigned long milliseconds);
+  bool isLimited() { return maxSteps != 0 || hasDeadline; }
+
+  void step() {
+    if (++steps >= nextCheck) {
+      check();
+    }
+  }
+  unsigned long getSteps() { return steps; }
+
+  static const unsigned long CLOCK_INTERVAL = 1024;
+
+private:
+  // Throws if the budget is spent, and sets the step of the next check
+  void check();
+
+  unsigned long steps;
+  unsigned long maxSteps;
+  unsigned long nextCheck;
+  bool hasDeadline;
+  std::chrono::steady_clock::time_point deadline;
+  unsigned long timeout;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,108 @@
+#include "bytecode.h"
+
+#include <iomanip>
+
+namespace napkin {
+
+/**
+ * Names of the opcodes, in the order of OpCode.
+ */
+static const char *opCodeNames[] = {
+    "CONSTANT",     "NIL",          "POP",           "GET_LOCAL",
+    "SET_LOCAL",    "DECLARE_LOCAL", "GET_BOXED",    "SET_BOXED",
+    "DECLARE_BOXED", "GET_GLOBAL",  "SET_GLOBAL",
+    "DECLARE_GLOBAL", "ADD",        "SUBTRACT",      "MULTIPLY",
+    "DIVIDE",       "POWER",        "EQUAL",         "NOT_EQUAL",
+    "OR",           "AND",          "LESS",          "LESS_EQUAL",
+    "GREATER",      "GREATER_EQUAL", "NEGATE",       "J",
+    "NOT",          "JUMP",         "JUMP_IF_FALSE", "LOOP",
+    "PUSH_FRAME",   "POP_FRAME",    "CLOSURE",       "CALL",
+    "TAIL_CALL",    "RETURN",       "OUTPUT",        "HALT",
+};
+
+void CompiledFunction::disassemble(std::ostream &out) {
+  out << "== " << name << " (" << slotCount << " slots, stack "
+      << maxStack << ") ==" << std::endl;
+  unsigned long offset = 0;
+  while (offset < code.size()) {
+    offset = disassembleInstruction(out, offset);
+  }
+  for (unsigned long i = 0; i < functions.size(); i++) {
+    out << std::endl;
+    functions[i]->disassemble(out);
+  }
+}
+
+/**
+ * Prints one instruction and returns the offset of the next one.
+ */
+unsigned long CompiledFunction::disassembleInstruction(std::ostream &out,
+                                                      unsigned long offset) {
+  OpCode op = (OpCode)code[offset];
+  out << std::setw(5) << offset << std::setw(5) << lines[offset] << "  "
+      << std::left << std::setw(16) << opCodeNames[op] << std::right;
+  switch (op) {
+  case OP_CONSTANT:
+    out << constants[readShort(offset + 1)].repr() << std::endl;
+    return offset + 3;
+  case OP_GET_LOCAL:
+  case OP_DECLARE_LOCAL:
+  case OP_GET_BOXED:
+  case OP_DECLARE_BOXED:
+    out << readShort(offset + 1) << " " << readShort(offset + 3) << " '"
+        << names[readShort(offset + 5)] << "'" << std::endl;
+    return offset + 7;
+  case OP_SET_LOCAL:
+  case OP_SET_BOXED:
+    out << readShort(offset + 1) << " " << readShort(offset + 3) << std::endl;
+    return offset + 5;
+  case OP_GET_GLOBAL:
+  case OP_SET_GLOBAL:
+  case OP_DECLARE_GLOBAL:
+    out << "'" << names[readShort(offset + 1)] << "'" << std::endl;
+    return offset + 3;
+  case OP_ADD:
+  case OP_SUBTRACT:
+  case OP_MULTIPLY:
+  case OP_DIVIDE:
+  case OP_POWER:
+  case OP_EQUAL:
+  case OP_NOT_EQUAL:
+  case OP_OR:
+  case OP_AND:
+  case OP_LESS:
+  case OP_LESS_EQUAL:
+  case OP_GREATER:
+  case OP_GREATER_EQUAL:
+  case OP_NEGATE:
+  case OP_J:
+  case OP_NOT:
+    if (code[offset + 1] & OPERATOR_CONTAINED) {
+      out << "(contained)";
+    }
+    out << std::endl;
+    return offset + 4;
+  case OP_JUMP:
+  case OP_JUMP_IF_FALSE:
+    out << "-> " << offset + 3 + readShort(offset + 1) << std::endl;
+    return offset + 3;
+  case OP_LOOP:
+    out << "-> " << offset + 3 - readShort(offset + 1) << std::endl;
+    return offset + 3;
+  case OP_PUSH_FRAME:
+    out << readShort(offset + 1) << std::endl;
+    return offset + 3;
+  case OP_CLOSURE:
+    out << functions[readShort(offset + 1)]->name << std::endl;
+    return offset + 5;
+  case OP_CALL:
+  case OP_TAIL_CALL:
+    out << (unsigned long)code[offset + 1] << std::endl;
+    return offset + 4;
+  default:
+    out << std::endl;
+    return offset + 1;
+  }
+}
+
+} // namespace napkin
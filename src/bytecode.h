@@ -0,0 +1,149 @@
+#ifndef NAPKIN_BYTECODE_H_
+#define NAPKIN_BYTECODE_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "environment.h"
+#include "token.h"
+#include "value.h"
+
+/**
+ * Bytecode executed by the VM.
+ */
+
+namespace napkin {
+
+class LambdaExpr;
+
+/**
+ * Instructions of the VM. Each opcode is one byte, followed by its operands.
+ * Operands are two bytes (high byte first) unless noted otherwise.
+ */
+enum OpCode : uint8_t {
+  // constant index
+  OP_CONSTANT,
+  OP_NIL,
+  OP_POP,
+
+  // depth, slot, name index (for error messages)
+  OP_GET_LOCAL,
+  // depth, slot
+  OP_SET_LOCAL,
+  // depth, slot, name index
+  OP_DECLARE_LOCAL,
+  // Same operands as the above, for variables held in a Cell
+  OP_GET_BOXED,
+  OP_SET_BOXED,
+  OP_DECLARE_BOXED,
+  // name index
+  OP_GET_GLOBAL,
+  OP_SET_GLOBAL,
+  OP_DECLARE_GLOBAL,
+
+  // Operators take a flags byte (see OPERATOR_CONTAINED) and a site index
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_POWER,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_OR,
+  OP_AND,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_NEGATE,
+  OP_J,
+  OP_NOT,
+
+  // offset forwards
+  OP_JUMP,
+  OP_JUMP_IF_FALSE,
+  // offset backwards
+  OP_LOOP,
+
+  // slot count
+  OP_PUSH_FRAME,
+  OP_POP_FRAME,
+
+  // function index, site index
+  OP_CLOSURE,
+  // argument count (one byte), site index
+  OP_CALL,
+  // Same operands, for calls in tail position: the callee replaces the
+  // calling frame
+  OP_TAIL_CALL,
+  OP_RETURN,
+
+  OP_OUTPUT,
+  OP_HALT,
+};
+
+// Set in an operator's flags if its result can go into the call's region
+// (see BinaryExpr::escapes)
+const uint8_t OPERATOR_CONTAINED = 1;
+
+/**
+ * Bytecode for the body of a lambda or the top level of a script.
+ * Compiled functions are created by the Compiler in the arena that owns the
+ * AST they were compiled from.
+ */
+class CompiledFunction {
+public:
+  CompiledFunction(std::string t_name)
+      : name(t_name), lambda(nullptr), slotCount(0), maxStack(0),
+        usesRegion(false){};
+
+  // Prints a listing of the function and the functions nested in it
+  void disassemble(std::ostream &out);
+
+  std::string name;
+  // The lambda that closures of the function are created from (nullptr for
+  // the top level)
+  LambdaExpr *lambda;
+
+  std::vector<uint8_t> code;
+  // Line of the source that each byte of code was compiled from
+  std::vector<unsigned int> lines;
+
+  // Values of literals (pinned by the AST)
+  std::vector<Value> constants;
+  // Names of variables
+  std::vector<std::string> names;
+  // Where each name was last found as a global (same indices as names)
+  std::vector<GlobalCache> globals;
+  // Tokens that allocations are attributed to (see HeapProfiler)
+  std::vector<Token> sites;
+  // Lambdas created by the function
+  std::vector<CompiledFunction *> functions;
+
+  // Slots and names of the parameters in the call frame
+  std::vector<unsigned long> parameterSlots;
+  std::vector<std::string> parameterNames;
+  // True for the parameters closures capture
+  std::vector<bool> parameterBoxed;
+
+  // Size of the call frame
+  unsigned long slotCount;
+  // Most values the function ever has on the VM's stack at once
+  unsigned long maxStack;
+  // True if some operator's result goes into the call's region. Calls of
+  // other functions don't open a region.
+  bool usesRegion;
+
+private:
+  unsigned long disassembleInstruction(std::ostream &out,
+                                       unsigned long offset);
+  unsigned long readShort(unsigned long offset) {
+    return (code[offset] << 8) | code[offset + 1];
+  }
+};
+
+} // namespace napkin
+
+#endif
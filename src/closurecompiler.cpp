@@ -0,0 +1,616 @@
+#include "closurecompiler.h"
+
+namespace napkin {
+
+ClosureCompiler::ClosureCompiler(Interpreter *t_target, Arena *t_arena)
+    : target(t_target), arena(t_arena) {}
+
+std::vector<Code> ClosureCompiler::compile(std::vector<Stmt *> stmts) {
+  std::vector<Code> program;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    program.push_back(compileStmt(stmts[i]));
+  }
+  return program;
+}
+
+void ClosureCompiler::run(std::vector<Code> &program) {
+  for (unsigned long i = 0; i < program.size(); i++) {
+    safepoint(target);
+    program[i]();
+    if (target->returning) {
+      // Returned from outside of a function
+      throw ReturnException(target->takeReturnValue());
+    }
+  }
+}
+
+Code ClosureCompiler::compileStmt(Stmt *stmt) {
+  visitStmt(stmt);
+  return code;
+}
+
+Code ClosureCompiler::compileExpr(Expr *expr) {
+  expr->accept(this);
+  return code;
+}
+
+void ClosureCompiler::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void ClosureCompiler::visitExprStmt(ExprStmt *stmt) {
+  Code expr = compileExpr(stmt->expr);
+  Interpreter *interpreter = target;
+  if (!interpreter->repl) {
+    code = expr;
+    return;
+  }
+  // If running in repl, print the result
+  code = [expr]() {
+    Value result = expr();
+    if (!result.isNull()) {
+      std::cout << result.repr() << std::endl;
+    }
+    return result;
+  };
+}
+
+void ClosureCompiler::visitOutputStmt(OutputStmt *stmt) {
+  Code expr = compileExpr(stmt->expr);
+  code = [expr]() {
+    Value result = expr();
+    if (!result.isNull()) {
+      // Output the string representation of result
+      std::cout << result.repr() << std::endl;
+    } else {
+      std::cout << "nil" << std::endl;
+    }
+    return Value();
+  };
+}
+
+void ClosureCompiler::visitBlockStmt(BlockStmt *stmt) {
+  Code body = compileStatements(stmt->stmts);
+  if (!stmt->needsFrame) {
+    code = body;
+    return;
+  }
+  Interpreter *interpreter = target;
+  unsigned long slotCount = stmt->slotCount;
+  code = [interpreter, body, slotCount]() {
+    Environment *frame =
+        interpreter->acquireFrame(interpreter->environment, slotCount);
+    Value value = runInFrame(interpreter, body, frame);
+    interpreter->releaseFrame(frame);
+    return value;
+  };
+}
+
+void ClosureCompiler::visitIfStmt(IfStmt *stmt) {
+  Code condition = compileExpr(stmt->condition);
+  Code thenBranch = compileStmt(stmt->thenBranch);
+  if (stmt->elseBranch == nullptr) {
+    code = [condition, thenBranch]() {
+      if (isTruthy(condition())) {
+        return thenBranch();
+      }
+      return Value();
+    };
+    return;
+  }
+  Code elseBranch = compileStmt(stmt->elseBranch);
+  code = [condition, thenBranch, elseBranch]() {
+    if (isTruthy(condition())) {
+      return thenBranch();
+    }
+    return elseBranch();
+  };
+}
+
+void ClosureCompiler::visitWhileStmt(WhileStmt *stmt) {
+  Code condition = compileExpr(stmt->condition);
+  Code body = compileStmt(stmt->body);
+  Interpreter *interpreter = target;
+  Code loop = [interpreter, condition, body]() {
+    while (isTruthy(condition())) {
+      body();
+      if (interpreter->returning) {
+        break;
+      }
+      interpreter->budget.step();
+    }
+    return Value();
+  };
+  if (stmt->invariants.empty()) {
+    code = loop;
+    return;
+  }
+  // Each run of the loop computes its invariant operators anew, like
+  // Interpreter::visitWhileStmt
+  code = [interpreter, stmt, loop]() {
+    unsigned long enclosingRun = stmt->run;
+    stmt->run = ++interpreter->loopRuns;
+    interpreter->runningLoops.push_back(stmt);
+    try {
+      loop();
+    } catch (...) {
+      interpreter->endLoopRun(stmt, enclosingRun);
+      throw;
+    }
+    interpreter->endLoopRun(stmt, enclosingRun);
+    return Value();
+  };
+}
+
+void ClosureCompiler::visitReturnStmt(ReturnStmt *stmt) {
+  Code value = nullptr;
+  if (stmt->value != nullptr) {
+    value = compileExpr(stmt->value);
+  }
+  Interpreter *interpreter = target;
+  code = [interpreter, value]() {
+    Value result;
+    if (value) {
+      result = value();
+    }
+    // Keep the value reachable until the callsite picks it up
+    interpreter->returnValue = result;
+    interpreter->returning = true;
+    return result;
+  };
+}
+
+void ClosureCompiler::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+/**
+ * The body is compiled once, here, and run by NClosure::call.
+ */
+void ClosureCompiler::visitLambdaExpr(LambdaExpr *expr) {
+  Code body = compileStatements(expr->body->stmts);
+  Interpreter *interpreter = target;
+
+  ClosureCode *closureCode = arena->make<ClosureCode>();
+  closureCode->body = [interpreter, body](Environment *frame) {
+    return runInFrame(interpreter, body, frame);
+  };
+  expr->code = closureCode;
+
+  code = [interpreter, expr]() {
+    AllocationSite site(expr->arrow);
+    return Value(new NClosure(expr, interpreter->environment));
+  };
+}
+
+void ClosureCompiler::visitVarDeclExpr(VarDeclExpr *expr) {
+  Code value = compileExpr(expr->value);
+  Interpreter *interpreter = target;
+  if (expr->slot < 0) {
+    code = [interpreter, expr, value]() {
+      Value result = value();
+      interpreter->globals->declareVar(expr->name.getLexeme(), result);
+      return result;
+    };
+  } else if (expr->boxed) {
+    code = [interpreter, expr, value]() {
+      Value result = value();
+      interpreter->environment->ancestor(expr->depth)
+          ->declareBoxed(expr->slot, expr->name.getLexeme(), result);
+      return result;
+    };
+  } else {
+    code = [interpreter, expr, value]() {
+      Value result = value();
+      interpreter->environment->ancestor(expr->depth)
+          ->declareSlot(expr->slot, expr->name.getLexeme(), result);
+      return result;
+    };
+  }
+  if (expr->invalidatesMemos) {
+    code = invalidateMemos(interpreter, code);
+  }
+}
+
+void ClosureCompiler::visitAssignExpr(AssignExpr *expr) {
+  Code value = compileExpr(expr->value);
+  Interpreter *interpreter = target;
+  if (expr->slot < 0) {
+    code = [interpreter, expr, value]() {
+      Value result = value();
+      Value *binding = interpreter->globals->find(&expr->cache);
+      if (binding != nullptr) {
+        *binding = result;
+      } else {
+        interpreter->globals->bind(expr->name.getLexeme(), result);
+      }
+      return result;
+    };
+  } else if (expr->boxed) {
+    unsigned long depth = expr->depth;
+    unsigned long slot = expr->slot;
+    code = [interpreter, depth, slot, value]() {
+      Value result = value();
+      interpreter->environment->ancestor(depth)->setBoxed(slot, result);
+      return result;
+    };
+  } else if (expr->depth == 0) {
+    unsigned long slot = expr->slot;
+    code = [interpreter, slot, value]() {
+      Value result = value();
+      interpreter->environment->setSlot(slot, result);
+      return result;
+    };
+  } else {
+    unsigned long depth = expr->depth;
+    unsigned long slot = expr->slot;
+    code = [interpreter, depth, slot, value]() {
+      Value result = value();
+      interpreter->environment->ancestor(depth)->setSlot(slot, result);
+      return result;
+    };
+  }
+  if (expr->invalidatesMemos) {
+    code = invalidateMemos(interpreter, code);
+  }
+}
+
+void ClosureCompiler::visitBinaryExpr(BinaryExpr *expr) {
+  Code left = compileExpr(expr->left);
+  Code right = compileExpr(expr->right);
+  switch (expr->_operator.getTokenType()) {
+  case TOKEN_PLUS:
+    code = binary<nAdd, TOKEN_PLUS>(target, expr, left, right);
+    break;
+  case TOKEN_MINUS:
+    code = binary<nSubtract, TOKEN_MINUS>(target, expr, left, right);
+    break;
+  case TOKEN_STAR:
+    code = binary<nMultiply, TOKEN_STAR>(target, expr, left, right);
+    break;
+  case TOKEN_STAR_STAR:
+    code = binary<nPower, TOKEN_STAR_STAR>(target, expr, left, right);
+    break;
+  case TOKEN_SLASH:
+    code = binary<nDivide, TOKEN_SLASH>(target, expr, left, right);
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    code = binary<nLogicalEqual, TOKEN_EQUAL_EQUAL>(target, expr, left, right);
+    break;
+  case TOKEN_BANG_EQUAL:
+    code = binary<nLogicalNotEqual, TOKEN_BANG_EQUAL>(target, expr, left,
+                                                      right);
+    break;
+  case TOKEN_OR:
+    code = binary<nLogicalOr, TOKEN_OR>(target, expr, left, right);
+    break;
+  case TOKEN_AND:
+    code = binary<nLogicalAnd, TOKEN_AND>(target, expr, left, right);
+    break;
+  case TOKEN_LESS_EQUAL:
+    code = binary<nLessEqual, TOKEN_LESS_EQUAL>(target, expr, left, right);
+    break;
+  case TOKEN_GREATER_EQUAL:
+    code = binary<nGreaterEqual, TOKEN_GREATER_EQUAL>(target, expr, left,
+                                                      right);
+    break;
+  case TOKEN_LESS:
+    code = binary<nLess, TOKEN_LESS>(target, expr, left, right);
+    break;
+  case TOKEN_GREATER:
+    code = binary<nGreater, TOKEN_GREATER>(target, expr, left, right);
+    break;
+  default:
+    // should be unreachable if parser is set up correctly
+    throw ImplementationException("binary operator not handled in switch.");
+  }
+  if (expr->invariant != nullptr) {
+    code = invariant(expr->invariant, code);
+  }
+}
+
+void ClosureCompiler::visitGrouping(Grouping *expr) {
+  expr->contents->accept(this);
+}
+
+void ClosureCompiler::visitUnaryExpr(UnaryExpr *expr) {
+  Code right = compileExpr(expr->right);
+  switch (expr->_operator.getTokenType()) {
+  case TOKEN_MINUS:
+    code = unary<nNegate>(expr, right);
+    break;
+  case TOKEN_J:
+    // 'j' may be used as an operator meaning "multiply by j1"
+    code = unary<nJ>(expr, right);
+    break;
+  case TOKEN_BANG:
+  case TOKEN_NOT:
+    code = unary<nNot>(expr, right);
+    break;
+  default:
+    // should be unreachable if parser is set up correctly
+    throw ImplementationException("unary operator not handled.");
+  }
+  if (expr->invariant != nullptr) {
+    code = invariant(expr->invariant, code);
+  }
+}
+
+void ClosureCompiler::visitCallExpr(CallExpr *expr) {
+  Code callee = compileExpr(expr->callee);
+  std::vector<Code> arguments;
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    arguments.push_back(compileExpr(expr->arguments[i]));
+  }
+  Interpreter *interpreter = target;
+  code = [interpreter, expr, callee, arguments]() {
+    ArgumentScope scope(interpreter->argumentStack);
+    Value *values = interpreter->argumentStack.push(arguments.size() + 1);
+    Value function = callee();
+    values[0] = function;
+
+    // Evaluate each argument in order
+    for (unsigned long i = 0; i < arguments.size(); i++) {
+      values[i + 1] = arguments[i]();
+    }
+    Arguments callArguments(values + 1, arguments.size());
+
+    if (!(function.getType() == N_CALLABLE)) {
+      throw RuntimeException("object not callable.");
+    }
+    NCallable *callable = (NCallable *)function.asObject();
+    if (callArguments.size() != (unsigned long)callable->arity()) {
+      throw RuntimeException("expected " + std::to_string(callable->arity()) +
+                             " arguments but got " +
+                             std::to_string(callArguments.size()) + ".");
+    }
+    if (expr->tail) {
+      interpreter->requestTailCall(function, callArguments, &expr->paren);
+      return Value();
+    }
+    AllocationSite site(expr->paren);
+    if (callable->asClosure() == nullptr) {
+      interpreter->noteSideEffect();
+    }
+    return callable->call(interpreter, callArguments);
+  };
+}
+
+void ClosureCompiler::visitIdentifier(Identifier *expr) {
+  Interpreter *interpreter = target;
+  // Names bound to nil are treated as undefined
+  if (expr->slot < 0) {
+    code = [interpreter, expr]() {
+      Value *binding = interpreter->globals->find(&expr->cache);
+      Value value = binding != nullptr ? *binding : Value::undefined();
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               expr->token.getLexeme() + "'.");
+      }
+      return value;
+    };
+  } else if (expr->boxed) {
+    code = [interpreter, expr]() {
+      Value value =
+          interpreter->environment->ancestor(expr->depth)->getBoxed(expr->slot);
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               expr->token.getLexeme() + "'.");
+      }
+      return value;
+    };
+  } else if (expr->depth == 0) {
+    unsigned long slot = expr->slot;
+    code = [interpreter, expr, slot]() {
+      Value value = interpreter->environment->getSlot(slot);
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               expr->token.getLexeme() + "'.");
+      }
+      return value;
+    };
+  } else {
+    code = [interpreter, expr]() {
+      Value value =
+          interpreter->environment->ancestor(expr->depth)->getSlot(expr->slot);
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               expr->token.getLexeme() + "'.");
+      }
+      return value;
+    };
+  }
+}
+
+void ClosureCompiler::visitRealNumber(RealNumber *expr) {
+  Value constant = expr->constant;
+  code = [constant]() { return constant; };
+}
+
+void ClosureCompiler::visitImaginaryNumber(ImaginaryNumber *expr) {
+  Value constant = expr->constant;
+  code = [constant]() { return constant; };
+}
+
+void ClosureCompiler::visitString(String *expr) {
+  Value constant = expr->constant;
+  code = [constant]() { return constant; };
+}
+
+void ClosureCompiler::visitBoolean(Boolean *expr) {
+  Value constant = expr->constant;
+  code = [constant]() { return constant; };
+}
+
+void ClosureCompiler::visitKeywordConstant(KeywordConstant *expr) {
+  Value constant = expr->constant;
+  if (constant.isUndefined()) {
+    code = []() -> Value {
+      throw ImplementationException(
+          "Keyword constant not handled in interpreter.");
+    };
+    return;
+  }
+  code = [constant]() { return constant; };
+}
+
+Code ClosureCompiler::compileStatements(std::vector<Stmt *> &stmts) {
+  std::vector<Code> statements;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    statements.push_back(compileStmt(stmts[i]));
+  }
+  Interpreter *interpreter = target;
+  return [interpreter, statements]() {
+    // Captures the value of the last statement
+    Value value;
+    for (unsigned long i = 0; i < statements.size(); i++) {
+      safepoint(interpreter);
+      value = statements[i]();
+      if (interpreter->returning) {
+        break;
+      }
+    }
+    return value;
+  };
+}
+
+/**
+ * The operator is a template argument, so real numbers take the fast path of
+ * Interpreter::visitBinaryExpr without type feedback. Other operands may
+ * specialize on complex numbers like in the Interpreter.
+ */
+template <Value (*op)(Value, Value), TokenType _operator>
+Code ClosureCompiler::binary(Interpreter *interpreter, BinaryExpr *expr,
+                             Code left, Code right) {
+  // Results that can't escape the current call go into its region
+  bool contained = !expr->escapes;
+  return [interpreter, expr, left, right, contained]() {
+    TempRootScope scope(interpreter->tempRoots);
+    Value leftValue = left();
+    // Evaluating the right operand may call a function and trigger a
+    // collection
+    if (leftValue.isObject()) {
+      interpreter->tempRoots.push_back(leftValue);
+    }
+    Value rightValue = right();
+    // Operators on real numbers never allocate
+    if (leftValue.isNumber() && rightValue.isNumber()) {
+      if (_operator == TOKEN_OR || _operator == TOKEN_AND) {
+        return op(leftValue, rightValue);
+      }
+      return operateReal(_operator, leftValue.asNumber(),
+                         rightValue.asNumber());
+    }
+
+    RegionAllocation allocation(contained);
+    AllocationSite site(expr->_operator);
+    TypeFeedback &feedback = expr->feedback;
+    if (feedback.specialization == SPECIALIZATION_COMPLEX) {
+      if (areComplexNumbers(leftValue, rightValue)) {
+        return operateComplex(_operator, (NComplexNumber *)leftValue.asObject(),
+                              (NComplexNumber *)rightValue.asObject());
+      }
+      feedback.deoptimize();
+    } else if (feedback.specialization == SPECIALIZATION_NONE) {
+      feedback.observe(operandTypes(_operator, leftValue, rightValue));
+    }
+    return op(leftValue, rightValue);
+  };
+}
+
+/**
+ * Same as binary: negating a real number needs no type feedback.
+ */
+template <Value (*op)(Value)>
+Code ClosureCompiler::unary(UnaryExpr *expr, Code right) {
+  bool contained = !expr->escapes;
+  bool negation = expr->_operator.getTokenType() == TOKEN_MINUS;
+  return [expr, right, contained, negation]() {
+    Value rightValue = right();
+    if (negation && rightValue.isNumber()) {
+      return Value(-rightValue.asNumber());
+    }
+
+    RegionAllocation allocation(contained);
+    AllocationSite site(expr->_operator);
+    TypeFeedback &feedback = expr->feedback;
+    if (feedback.specialization == SPECIALIZATION_COMPLEX) {
+      if (isComplexNumber(rightValue)) {
+        NComplexNumber *number = (NComplexNumber *)rightValue.asObject();
+        return Value(new NComplexNumber(-number->re, -number->im));
+      }
+      feedback.deoptimize();
+    } else if (feedback.specialization == SPECIALIZATION_NONE && negation) {
+      feedback.observe(isComplexNumber(rightValue) ? SPECIALIZATION_COMPLEX
+                                                   : SPECIALIZATION_GENERIC);
+    }
+    return op(rightValue);
+  };
+}
+
+/**
+ * Reuses the value of a loop invariant operator for the rest of its loop's
+ * run, like Interpreter::visitBinaryExpr.
+ */
+Code ClosureCompiler::invariant(LoopInvariant *invariant, Code operation) {
+  return [invariant, operation]() {
+    if (invariant->run != invariant->loop->run) {
+      invariant->value = operation();
+      invariant->run = invariant->loop->run;
+    }
+    return invariant->value;
+  };
+}
+
+/**
+ * The epoch moves on once the variable holds its new value, like in the
+ * Interpreter.
+ */
+Code ClosureCompiler::invalidateMemos(Interpreter *interpreter,
+                                      Code assignment) {
+  return [interpreter, assignment]() {
+    Value result = assignment();
+    interpreter->invalidateMemos();
+    return result;
+  };
+}
+
+/**
+ * Statements in blocks and at the top level start at a safe point, and count
+ * as a step, like in the Interpreter.
+ */
+void ClosureCompiler::safepoint(Interpreter *interpreter) {
+  if (heap()->collectionRequested()) {
+    interpreter->collectGarbage();
+  }
+  if (heap()->getProfiler() != nullptr) {
+    heap()->getProfiler()->poll();
+  }
+  interpreter->budget.step();
+}
+
+/**
+ * Runs compiled statements with the frame as the current environment.
+ */
+Value ClosureCompiler::runInFrame(Interpreter *interpreter, const Code &body,
+                                  Environment *frame) {
+  Environment *previous = interpreter->environment;
+  interpreter->environmentStack.push_back(previous);
+  interpreter->environment = frame;
+
+  // The previous environment must be restored if the body throws
+  Value value;
+  try {
+    value = body();
+  } catch (...) {
+    interpreter->environment = previous;
+    interpreter->environmentStack.pop_back();
+    throw;
+  }
+
+  interpreter->environment = previous;
+  interpreter->environmentStack.pop_back();
+  return value;
+}
+
+} // namespace napkin
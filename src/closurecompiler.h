@@ -0,0 +1,108 @@
+#ifndef NAPKIN_CLOSURECOMPILER_H_
+#define NAPKIN_CLOSURECOMPILER_H_
+
+#include <functional>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+#include "arena.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "value.h"
+
+namespace napkin {
+
+// A statement or expression compiled into a C++ function object. Running it
+// evaluates the node in the interpreter's current environment.
+typedef std::function<Value()> Code;
+
+/**
+ * Compiled body of a lambda (see LambdaExpr::code). Runs the body in the call
+ * frame it is given, like Interpreter::executeBlockStmt.
+ */
+class ClosureCode {
+public:
+  std::function<Value(Environment *)> body;
+};
+
+/**
+ * Turns every node of the AST, once, into a function object specialized for
+ * that node: the operator of a BinaryExpr, whether an Identifier is a global
+ * or a local (and at which depth), etc. are decided at compile time, so
+ * running the code doesn't go through accept() or decode tokens.
+ *
+ * The code runs on an Interpreter's state (environments, temporary roots,
+ * frame pool), so it has exactly the same semantics as walking the tree.
+ * Returning from a function raises the interpreter's returning signal, like
+ * Interpreter::visitReturnStmt. Loop invariant operators are cached and
+ * complex arithmetic is specialized like in the Interpreter.
+ *
+ * What this saves is the dispatch per node and the checks of the generic
+ * operators on real numbers, which is where loops and arithmetic spend their
+ * time. Calls go through the same frames, regions and argument stack as in
+ * the Interpreter, so call-bound code such as deep recursion runs at about the
+ * speed of the tree walker.
+ */
+class ClosureCompiler : public ASTVisitor<void> {
+public:
+  ClosureCompiler(Interpreter *t_target, Arena *t_arena);
+
+  std::vector<Code> compile(std::vector<Stmt *> stmts);
+  // Runs compiled top level statements
+  void run(std::vector<Code> &program);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  Code compileStmt(Stmt *stmt);
+  Code compileExpr(Expr *expr);
+  // Code for a list of statements that evaluates to the value of the last one
+  Code compileStatements(std::vector<Stmt *> &stmts);
+
+  template <Value (*op)(Value, Value), TokenType _operator>
+  static Code binary(Interpreter *interpreter, BinaryExpr *expr, Code left,
+                     Code right);
+  template <Value (*op)(Value)>
+  static Code unary(UnaryExpr *expr, Code right);
+  // Caches the value of a loop invariant operator
+  static Code invariant(LoopInvariant *invariant, Code operation);
+
+  // Wraps an assignment that invalidates memoized results
+  static Code invalidateMemos(Interpreter *interpreter, Code assignment);
+  static void safepoint(Interpreter *interpreter);
+  // Same as Interpreter::executeBlockStmt
+  static Value runInFrame(Interpreter *interpreter, const Code &body,
+                          Environment *frame);
+
+  // Interpreter whose state the code runs on
+  Interpreter *target;
+  // Owns the ClosureCode of the lambdas
+  Arena *arena;
+  // Result of the last visit
+  Code code;
+};
+
+} // namespace napkin
+
+#endif
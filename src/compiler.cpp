@@ -0,0 +1,388 @@
+#include "compiler.h"
+
+namespace napkin {
+
+Compiler::Compiler(Arena *t_arena) : arena(t_arena) {
+  function = nullptr;
+  stackDepth = 0;
+  line = 0;
+}
+
+CompiledFunction *Compiler::compile(std::vector<Stmt *> stmts) {
+  function = arena->make<CompiledFunction>("<script>");
+  stackDepth = 0;
+  // Top level statements are only run for their effects
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    visitStmt(stmts[i]);
+    emitOp(OP_POP, -1);
+  }
+  emitOp(OP_HALT, 0);
+  return function;
+}
+
+void Compiler::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void Compiler::visitExprStmt(ExprStmt *stmt) {
+  stmt->expr->accept(this);
+}
+
+/**
+ * Output statements evaluate to nil, which OP_OUTPUT leaves in place of the
+ * value it prints.
+ */
+void Compiler::visitOutputStmt(OutputStmt *stmt) {
+  stmt->expr->accept(this);
+  emitOp(OP_OUTPUT, 0);
+}
+
+void Compiler::visitBlockStmt(BlockStmt *stmt) {
+  if (stmt->needsFrame) {
+    emitOp(OP_PUSH_FRAME, 0);
+    emitShort(stmt->slotCount);
+  }
+  compileStatements(stmt->stmts);
+  if (stmt->needsFrame) {
+    emitOp(OP_POP_FRAME, 0);
+  }
+}
+
+void Compiler::visitIfStmt(IfStmt *stmt) {
+  stmt->condition->accept(this);
+  unsigned long elseJump = emitJump(OP_JUMP_IF_FALSE, -1);
+  stmt->thenBranch->accept(this);
+  unsigned long endJump = emitJump(OP_JUMP, 0);
+
+  // Only one of the branches leaves a value
+  stackDepth--;
+  patchJump(elseJump);
+  if (stmt->elseBranch != nullptr) {
+    stmt->elseBranch->accept(this);
+  } else {
+    emitOp(OP_NIL, 1);
+  }
+  patchJump(endJump);
+}
+
+/**
+ * Loops evaluate to nil.
+ */
+void Compiler::visitWhileStmt(WhileStmt *stmt) {
+  unsigned long start = function->code.size();
+  stmt->condition->accept(this);
+  unsigned long exitJump = emitJump(OP_JUMP_IF_FALSE, -1);
+  stmt->body->accept(this);
+  emitOp(OP_POP, -1);
+  emitLoop(start);
+  patchJump(exitJump);
+  emitOp(OP_NIL, 1);
+}
+
+void Compiler::visitReturnStmt(ReturnStmt *stmt) {
+  line = stmt->keyword.getLine();
+  if (stmt->value != nullptr) {
+    stmt->value->accept(this);
+  } else {
+    emitOp(OP_NIL, 1);
+  }
+  emitOp(OP_RETURN, 0);
+}
+
+void Compiler::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+/**
+ * Compiles the body of the lambda into a function of its own. The parameters
+ * and the top level of the body share the call frame.
+ */
+void Compiler::visitLambdaExpr(LambdaExpr *expr) {
+  line = expr->arrow.getLine();
+  CompiledFunction *enclosing = function;
+  unsigned long enclosingDepth = stackDepth;
+
+  function = arena->make<CompiledFunction>(
+      "<lambda " + std::to_string(expr->arrow.getLine()) + ":" +
+      std::to_string(expr->arrow.getColumn()) + ">");
+  function->lambda = expr;
+  stackDepth = 0;
+  for (unsigned long i = 0; i < expr->parameters.size(); i++) {
+    function->parameterSlots.push_back(expr->parameters[i]->slot);
+    function->parameterNames.push_back(expr->parameters[i]->token.getLexeme());
+    function->parameterBoxed.push_back(expr->parameters[i]->boxed);
+  }
+  function->slotCount = expr->body->slotCount;
+  compileStatements(expr->body->stmts);
+  emitOp(OP_RETURN, 0);
+  expr->function = function;
+
+  CompiledFunction *compiled = function;
+  function = enclosing;
+  stackDepth = enclosingDepth;
+  line = expr->arrow.getLine();
+  function->functions.push_back(compiled);
+  emitOp(OP_CLOSURE, 1);
+  emitShort(function->functions.size() - 1);
+  emitShort(addSite(expr->arrow));
+}
+
+void Compiler::visitVarDeclExpr(VarDeclExpr *expr) {
+  expr->value->accept(this);
+  line = expr->name.getLine();
+  if (expr->slot < 0) {
+    emitOp(OP_DECLARE_GLOBAL, 0);
+    emitShort(addName(expr->name.getLexeme()));
+  } else {
+    emitOp(expr->boxed ? OP_DECLARE_BOXED : OP_DECLARE_LOCAL, 0);
+    emitShort(expr->depth);
+    emitShort(expr->slot);
+    emitShort(addName(expr->name.getLexeme()));
+  }
+}
+
+void Compiler::visitAssignExpr(AssignExpr *expr) {
+  expr->value->accept(this);
+  line = expr->name.getLine();
+  if (expr->slot < 0) {
+    emitOp(OP_SET_GLOBAL, 0);
+    emitShort(addName(expr->name.getLexeme()));
+  } else {
+    emitOp(expr->boxed ? OP_SET_BOXED : OP_SET_LOCAL, 0);
+    emitShort(expr->depth);
+    emitShort(expr->slot);
+  }
+}
+
+void Compiler::visitBinaryExpr(BinaryExpr *expr) {
+  expr->left->accept(this);
+  expr->right->accept(this);
+
+  OpCode op;
+  switch (expr->_operator.getTokenType()) {
+  case TOKEN_PLUS:
+    op = OP_ADD;
+    break;
+  case TOKEN_MINUS:
+    op = OP_SUBTRACT;
+    break;
+  case TOKEN_STAR:
+    op = OP_MULTIPLY;
+    break;
+  case TOKEN_STAR_STAR:
+    op = OP_POWER;
+    break;
+  case TOKEN_SLASH:
+    op = OP_DIVIDE;
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    op = OP_EQUAL;
+    break;
+  case TOKEN_BANG_EQUAL:
+    op = OP_NOT_EQUAL;
+    break;
+  case TOKEN_OR:
+    op = OP_OR;
+    break;
+  case TOKEN_AND:
+    op = OP_AND;
+    break;
+  case TOKEN_LESS_EQUAL:
+    op = OP_LESS_EQUAL;
+    break;
+  case TOKEN_GREATER_EQUAL:
+    op = OP_GREATER_EQUAL;
+    break;
+  case TOKEN_LESS:
+    op = OP_LESS;
+    break;
+  case TOKEN_GREATER:
+    op = OP_GREATER;
+    break;
+  default:
+    // should be unreachable if parser is set up correctly
+    throw ImplementationException("binary operator not handled in compiler.");
+  }
+  emitOperator(op, -1, expr->escapes, expr->_operator);
+}
+
+void Compiler::visitGrouping(Grouping *expr) {
+  expr->contents->accept(this);
+}
+
+void Compiler::visitUnaryExpr(UnaryExpr *expr) {
+  expr->right->accept(this);
+
+  OpCode op;
+  switch (expr->_operator.getTokenType()) {
+  case TOKEN_MINUS:
+    op = OP_NEGATE;
+    break;
+  case TOKEN_J:
+    op = OP_J;
+    break;
+  case TOKEN_BANG:
+  case TOKEN_NOT:
+    op = OP_NOT;
+    break;
+  default:
+    // should be unreachable if parser is set up correctly
+    throw ImplementationException("unary operator not handled in compiler.");
+  }
+  emitOperator(op, 0, expr->escapes, expr->_operator);
+}
+
+void Compiler::visitCallExpr(CallExpr *expr) {
+  expr->callee->accept(this);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    expr->arguments[i]->accept(this);
+  }
+  line = expr->paren.getLine();
+  if (expr->arguments.size() > 255) {
+    throw CompileException("can't call a function with more than 255 "
+                           "arguments.");
+  }
+  emitOp(expr->tail ? OP_TAIL_CALL : OP_CALL, -(int)expr->arguments.size());
+  emitByte(expr->arguments.size());
+  emitShort(addSite(expr->paren));
+}
+
+void Compiler::visitIdentifier(Identifier *expr) {
+  line = expr->token.getLine();
+  if (expr->slot < 0) {
+    emitOp(OP_GET_GLOBAL, 1);
+    emitShort(addName(expr->token.getLexeme()));
+  } else {
+    emitOp(expr->boxed ? OP_GET_BOXED : OP_GET_LOCAL, 1);
+    emitShort(expr->depth);
+    emitShort(expr->slot);
+    emitShort(addName(expr->token.getLexeme()));
+  }
+}
+
+void Compiler::visitRealNumber(RealNumber *expr) {
+  emitOp(OP_CONSTANT, 1);
+  emitShort(addConstant(expr->constant));
+}
+
+void Compiler::visitImaginaryNumber(ImaginaryNumber *expr) {
+  emitOp(OP_CONSTANT, 1);
+  emitShort(addConstant(expr->constant));
+}
+
+void Compiler::visitString(String *expr) {
+  line = expr->token.getLine();
+  emitOp(OP_CONSTANT, 1);
+  emitShort(addConstant(expr->constant));
+}
+
+void Compiler::visitBoolean(Boolean *expr) {
+  emitOp(OP_CONSTANT, 1);
+  emitShort(addConstant(expr->constant));
+}
+
+void Compiler::visitKeywordConstant(KeywordConstant *expr) {
+  if (expr->constant.isUndefined()) {
+    throw ImplementationException("Keyword constant not handled in compiler.");
+  }
+  emitOp(OP_CONSTANT, 1);
+  emitShort(addConstant(expr->constant));
+}
+
+void Compiler::compileStatements(std::vector<Stmt *> &stmts) {
+  if (stmts.empty()) {
+    emitOp(OP_NIL, 1);
+    return;
+  }
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    visitStmt(stmts[i]);
+    if (i != stmts.size() - 1) {
+      emitOp(OP_POP, -1);
+    }
+  }
+}
+
+void Compiler::emitOp(OpCode op, int stackEffect) {
+  emitByte(op);
+  stackDepth += stackEffect;
+  if (stackDepth > function->maxStack) {
+    function->maxStack = stackDepth;
+  }
+}
+
+void Compiler::emitByte(unsigned long byte) {
+  function->code.push_back(byte);
+  function->lines.push_back(line);
+}
+
+void Compiler::emitShort(unsigned long operand) {
+  if (operand > 0xffff) {
+    throw CompileException("function too large to compile.");
+  }
+  emitByte(operand >> 8);
+  emitByte(operand & 0xff);
+}
+
+unsigned long Compiler::emitJump(OpCode op, int stackEffect) {
+  emitOp(op, stackEffect);
+  emitByte(0xff);
+  emitByte(0xff);
+  return function->code.size() - 2;
+}
+
+/**
+ * Makes the jump whose operand is at the given offset land on the next
+ * instruction.
+ */
+void Compiler::patchJump(unsigned long operand) {
+  unsigned long distance = function->code.size() - operand - 2;
+  if (distance > 0xffff) {
+    throw CompileException("too much code to jump over.");
+  }
+  function->code[operand] = distance >> 8;
+  function->code[operand + 1] = distance & 0xff;
+}
+
+void Compiler::emitLoop(unsigned long start) {
+  emitOp(OP_LOOP, 0);
+  emitShort(function->code.size() + 2 - start);
+}
+
+void Compiler::emitOperator(OpCode op, int stackEffect, bool escapes,
+                            Token &_operator) {
+  line = _operator.getLine();
+  if (!escapes) {
+    function->usesRegion = true;
+  }
+  emitOp(op, stackEffect);
+  emitByte(escapes ? 0 : OPERATOR_CONTAINED);
+  emitShort(addSite(_operator));
+}
+
+unsigned long Compiler::addConstant(Value value) {
+  for (unsigned long i = 0; i < function->constants.size(); i++) {
+    if (function->constants[i] == value) {
+      return i;
+    }
+  }
+  function->constants.push_back(value);
+  return function->constants.size() - 1;
+}
+
+unsigned long Compiler::addName(std::string name) {
+  for (unsigned long i = 0; i < function->names.size(); i++) {
+    if (function->names[i] == name) {
+      return i;
+    }
+  }
+  function->names.push_back(name);
+  function->globals.push_back(GlobalCache(name));
+  return function->names.size() - 1;
+}
+
+unsigned long Compiler::addSite(Token &token) {
+  function->sites.push_back(token);
+  return function->sites.size() - 1;
+}
+
+} // namespace napkin
@@ -0,0 +1,80 @@
+#ifndef NAPKIN_COMPILER_H_
+#define NAPKIN_COMPILER_H_
+
+#include <string>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+#include "arena.h"
+#include "bytecode.h"
+#include "nexception.h"
+
+namespace napkin {
+
+/**
+ * Compiles a resolved and escape analyzed AST into bytecode for the VM.
+ * Every statement leaves its value on the stack, so blocks, ifs and function
+ * bodies evaluate to the value of their last statement like they do in the
+ * Interpreter. Variables are addressed by the slots the Resolver assigned.
+ */
+class Compiler : public ASTVisitor<void> {
+public:
+  Compiler(Arena *t_arena);
+
+  // Returns the function for the top level of a script
+  CompiledFunction *compile(std::vector<Stmt *> stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  // Compiles statements so that only the value of the last one is left
+  void compileStatements(std::vector<Stmt *> &stmts);
+
+  // stackEffect is the change in the number of values on the stack
+  void emitOp(OpCode op, int stackEffect);
+  void emitByte(unsigned long byte);
+  void emitShort(unsigned long operand);
+  // Emits a forward jump and returns the offset of its operand
+  unsigned long emitJump(OpCode op, int stackEffect);
+  void patchJump(unsigned long operand);
+  void emitLoop(unsigned long start);
+  void emitOperator(OpCode op, int stackEffect, bool escapes,
+                    Token &_operator);
+
+  unsigned long addConstant(Value value);
+  unsigned long addName(std::string name);
+  unsigned long addSite(Token &token);
+
+  Arena *arena;
+  // Function being compiled
+  CompiledFunction *function;
+  // Values on the stack at the current instruction
+  unsigned long stackDepth;
+  // Line of the node being compiled
+  unsigned int line;
+};
+
+} // namespace napkin
+
+#endif
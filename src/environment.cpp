@@ -3,83 +3,136 @@
 
 namespace napkin {
 
+// Version 0 marks an empty GlobalCache
+unsigned long Environment::nextVersion = 1;
+
 /**
- * Always creates a new binding in the current scope.
+ * Always creates a new global binding.
  * Will throw error if you try to re-declare a variable.
  */
-void Environment::declareVar(std::string name, NObject *value) {
-  if (map[name] != nullptr) {
+void Environment::declareVar(std::string name, Value value) {
+  if (map.count(name) != 0) {
     throw napkin::RuntimeException("variable \"" + name +
                                    "\" re-declared in scope.");
   }
   map[name] = value;
+  version = nextVersion++;
 }
 
 /**
- * Declares a new local binding if there is none, or reassignes a name to a new
- * value.
+ * Declares a new global binding if there is none, or reassignes a name to a
+ * new value.
  */
-void Environment::bind(std::string name, NObject *value) {
-  // If the name doesn't exist anywhere, create a new local binding
-  if (!existsSomewhere(name)) {
-    map[name] = value;
+void Environment::bind(std::string name, Value value) {
+  auto it = map.find(name);
+  if (it != map.end()) {
+    it->second = value;
     return;
   }
+  map[name] = value;
+  version = nextVersion++;
+}
 
-  // The name exists somewhere. Recurse until reach the environment where it
-  // exists and set it there
-  try {
-    // throws out_of_range if key doesn't exist
-    map.at(name);
-    // re-binds name in current environment
-    map[name] = value;
-  } catch (std::out_of_range) {
-    // Name not found in current environment so look in enclosing environment.
-    // Enclosing cannot be nullptr since if the name exists somewhere and we
-    // haven't found it yet, there must be at least one more outer environment
-    if (enclosing == nullptr) {
-      throw ImplementationException("in environmment.cpp: enclosing was null");
-    }
-    enclosing->bind(name, value);
+/**
+ * Returns the value associated with name in a global environment. Returns
+ * undefined if name hasn't been declared.
+ */
+Value Environment::lookup(std::string name) {
+  auto it = map.find(name);
+  if (it == map.end()) {
+    return Value::undefined();
   }
+  return it->second;
 }
 
 /**
- * Returns the value associated with name.
- * If the name hasn't been declared in this environment, with search the
- * enclosing environment. Returns nullptr if name hasn't been declared anywhere.
+ * Looks a name up in the map and fills the cache if it is bound.
+ * The map's nodes never move, so the binding stays valid until the version
+ * changes.
  */
-NObject *Environment::lookup(std::string name) {
-  try {
-    return map.at(name);
-  } catch (std::out_of_range) {
-    // Name not found in current environment so look in enclosing environment.
-    if (enclosing != nullptr) {
-      return enclosing->lookup(name);
-    }
-
-    // The name wasn't found in the current environment and there are no
-    // more enclosing environments.
+Value *Environment::findUncached(GlobalCache *cache) {
+  auto it = map.find(cache->name);
+  if (it == map.end()) {
     return nullptr;
   }
+  cache->version = version;
+  cache->binding = &it->second;
+  return cache->binding;
+}
+
+/**
+ * Returns the names bound in this environment's map.
+ */
+std::vector<std::string> Environment::getNames() {
+  std::vector<std::string> names;
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    names.push_back(it->first);
+  }
+  return names;
+}
+
+/**
+ * Declares a local variable.
+ * Will throw error if the variable was already declared in this frame.
+ */
+void Environment::declareSlot(unsigned long slot, const std::string &name,
+                              Value value) {
+  if (!slots[slot].isUndefined()) {
+    throw napkin::RuntimeException("variable \"" + name +
+                                   "\" re-declared in scope.");
+  }
+  slots[slot] = value;
 }
 
 /**
- * Returns true if name exists in current environment or any outer environment
+ * Declares a local variable that closures capture. A closure created before
+ * the declaration may have made the cell already, which then gets its value.
  */
-bool Environment::existsSomewhere(std::string name) {
-  try {
-    map.at(name); // throws out_of_range if key doesn't exist
-    return true;
-  } catch (std::out_of_range) {
-    if (enclosing != nullptr) {
-      return enclosing->existsSomewhere(name);
-    } else {
-      // name does not exist in current environment and there are no more outer
-      // environments
-      return false;
-    }
+void Environment::declareBoxed(unsigned long slot, const std::string &name,
+                               Value value) {
+  Cell *cell = capture(slot);
+  if (!cell->value.isUndefined()) {
+    throw napkin::RuntimeException("variable \"" + name +
+                                   "\" re-declared in scope.");
+  }
+  cell->value = value;
+}
+
+Cell *Environment::capture(unsigned long slot) {
+  if (slots[slot].isUndefined()) {
+    slots[slot] = Value(new Cell(Value::undefined()));
+  }
+  return (Cell *)slots[slot].asObject();
+}
+
+Environment *Environment::root() {
+  Environment *environment = this;
+  while (environment->enclosing != nullptr) {
+    environment = environment->enclosing;
+  }
+  return environment;
+}
+
+/**
+ * Clears all variables so the environment can be reused as a new frame.
+ * The slot array keeps its capacity, so refilling it is cheap.
+ */
+void Environment::reset(Environment *t_enclosing, unsigned long slotCount) {
+  slots.assign(slotCount, Value::undefined());
+  enclosing = t_enclosing;
+}
+
+/**
+ * Marks every value bound in this environment and the enclosing environment.
+ */
+void Environment::trace(Heap *heap) {
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    markValue(heap, it->second);
+  }
+  for (unsigned long i = 0; i < slots.size(); i++) {
+    markValue(heap, slots[i]);
   }
+  heap->mark(enclosing);
 }
 
 } // namespace napkin
@@ -3,35 +3,134 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-#include "nobject.h"
+#include "heap.h"
 #include "nexception.h"
+#include "nobject.h"
+#include "value.h"
 
 namespace napkin {
 
 /**
- * Stores mappings of names to values and offers methods to bind and
- * lookup names.
+ * A global name and where it was last found (see Environment::find). Kept by
+ * each use of a global in the AST or bytecode.
+ */
+struct GlobalCache {
+  GlobalCache(std::string t_name)
+      : name(t_name), version(0), binding(nullptr) {}
+  std::string name;
+  // Version of the environment the binding is in (0 if empty)
+  unsigned long version;
+  Value *binding;
+};
+
+/**
+ * A variable that closures capture (see Identifier::boxed). The variable's
+ * slot and the capture slot in the call frame of each closure capturing it
+ * hold the same cell, so they all see what is assigned to it.
+ * Cells are never visible to napkin code.
  */
-class Environment {
+class Cell : public NObject {
 public:
-  Environment() { enclosing = nullptr; };
-  Environment(Environment *t_enclosing) : enclosing(t_enclosing){};
-  void declareVar(std::string name, NObject *value);
-  void bind(std::string name, NObject *value);
-  NObject *lookup(std::string name);
+  Cell(Value t_value) : value(t_value){};
+  virtual NType getType() { return N_NULL; }
+  virtual const char *getTypeName() { return "cell"; }
+  virtual std::string repr() { return value.repr(); }
+  virtual void trace(Heap *heap) { markValue(heap, value); }
+
+  Value value;
+};
+
+/**
+ * A frame of variables.
+ * Local variables live in a flat array of slots that the Resolver assigns at
+ * parse time, so reading one is a few pointer hops with no hashing. The global
+ * environment also binds names in a hash map, since globals can be created at
+ * run time (e.g. by earlier lines in the repl).
+ * Closures only keep the cells of the variables they capture, so a frame can
+ * be recycled as soon as its block or call finishes. Environments still live
+ * on the garbage collected heap so the collector can trace them.
+ */
+class Environment : public HeapObject {
+public:
+  Environment() {
+    enclosing = nullptr;
+    version = nextVersion++;
+  };
+  Environment(Environment *t_enclosing, unsigned long slotCount)
+      : slots(slotCount, Value::undefined()), enclosing(t_enclosing) {
+    version = nextVersion++;
+  };
+
+  // Names bound in the global environment
+  void declareVar(std::string name, Value value);
+  void bind(std::string name, Value value);
+  Value lookup(std::string name);
+  std::vector<std::string> getNames();
+
+  // Returns where a cache's name is bound in the global environment, or
+  // nullptr. Finding the name again costs one comparison until a name is
+  // added to the environment.
+  Value *find(GlobalCache *cache) {
+    if (cache->version == version) {
+      return cache->binding;
+    }
+    return findUncached(cache);
+  }
+
+  // Local variables (undefined until declared)
+  Environment *ancestor(unsigned long depth) {
+    Environment *environment = this;
+    for (unsigned long i = 0; i < depth; i++) {
+      environment = environment->enclosing;
+    }
+    return environment;
+  }
+  Value getSlot(unsigned long slot) { return slots[slot]; }
+  void setSlot(unsigned long slot, Value value) { slots[slot] = value; }
+  void declareSlot(unsigned long slot, const std::string &name, Value value);
+
+  // Local variables that closures capture, whose slot holds a Cell once the
+  // variable is declared or captured
+  Value getBoxed(unsigned long slot) {
+    Value cell = slots[slot];
+    return cell.isUndefined() ? cell : ((Cell *)cell.asObject())->value;
+  }
+  void setBoxed(unsigned long slot, Value value) {
+    capture(slot)->value = value;
+  }
+  void declareBoxed(unsigned long slot, const std::string &name, Value value);
+  // Returns the cell of a variable, creating it if the variable isn't
+  // declared yet
+  Cell *capture(unsigned long slot);
+
+  // The global environment this frame is nested in
+  Environment *root();
+
+  // Frame recycling
+  void reset(Environment *t_enclosing, unsigned long slotCount);
+
+  virtual void trace(Heap *heap);
+  virtual const char *getTypeName() { return "environment"; }
 private:
-  // Hash map of names to napkin objects
+  Value *findUncached(GlobalCache *cache);
+
+  // Hash map of names to napkin values (global environments only)
   // It is important that the keys are strings and not tokens since names
   // are mapped independent of location
-  std::unordered_map<std::string, NObject *> map;
+  std::unordered_map<std::string, Value> map;
+
+  std::vector<Value> slots;
 
   // The environment "outside" the current block
-  // If lookup fails inside the inner scope, we search incrementally outward
   Environment *enclosing;
 
-  // Helpers
-  bool existsSomewhere(std::string name);
+  // Changes whenever a name is added to the map. Versions are never reused,
+  // even by other environments, so a cache can't match an environment that
+  // was freed and whose memory was reused.
+  unsigned long version;
+  static unsigned long nextVersion;
 };
 
 } // namespace napkin
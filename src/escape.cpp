@@ -0,0 +1,242 @@
+#include "escape.h"
+
+namespace napkin {
+
+EscapeAnalyzer::EscapeAnalyzer() {
+  marking = false;
+  use = USE_ESCAPES;
+  lastStmt = false;
+  blockDepth = 0;
+  stmtIndex = 0;
+}
+
+/**
+ * Analyzes a whole program, including the body of every lambda in it.
+ */
+void EscapeAnalyzer::analyze(std::vector<Stmt *> stmts) {
+  analyzeBody(stmts, nullptr);
+}
+
+/**
+ * Runs both passes over a function body (or the program if parameters is
+ * nullptr). Nested lambdas are analyzed during the first pass.
+ */
+void EscapeAnalyzer::analyzeBody(std::vector<Stmt *> &stmts,
+                                 std::vector<Identifier *> *parameters) {
+  // Save the state of the enclosing function
+  bool previousMarking = marking;
+  unsigned long previousBlockDepth = blockDepth;
+  long previousStmtIndex = stmtIndex;
+  bool previousLastStmt = lastStmt;
+
+  scopes.push_back(Scope());
+  scopes.back().isFunction = parameters != nullptr;
+  if (parameters != nullptr) {
+    // Arguments come from the caller
+    for (unsigned long i = 0; i < parameters->size(); i++) {
+      Name &name = scopes.back().names[(*parameters)[i]->token.getLexeme()];
+      name.escapes = true;
+    }
+  }
+
+  marking = false;
+  blockDepth = 0;
+  visitStmts(stmts);
+  marking = true;
+  blockDepth = 0;
+  visitStmts(stmts);
+
+  scopes.pop_back();
+  marking = previousMarking;
+  blockDepth = previousBlockDepth;
+  stmtIndex = previousStmtIndex;
+  lastStmt = previousLastStmt;
+}
+
+/**
+ * Visits the statements of a block. The value of a block is the value of its
+ * last statement, which may be returned from the call.
+ */
+void EscapeAnalyzer::visitStmts(std::vector<Stmt *> &stmts) {
+  blockDepth++;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    if (blockDepth == 1) {
+      stmtIndex = i;
+    }
+    lastStmt = i + 1 == stmts.size();
+    visitStmt(stmts[i]);
+  }
+  blockDepth--;
+}
+
+void EscapeAnalyzer::visit(Expr *expr, Use t_use) {
+  use = t_use;
+  expr->accept(this);
+}
+
+void EscapeAnalyzer::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void EscapeAnalyzer::visitExprStmt(ExprStmt *stmt) {
+  if (!marking && blockDepth == 1) {
+    VarDeclExpr *declaration = dynamic_cast<VarDeclExpr *>(stmt->expr);
+    if (declaration != nullptr) {
+      Name &name = scopes.back().names[declaration->name.getLexeme()];
+      name.declaredAt = stmtIndex;
+    }
+  }
+  visit(stmt->expr, lastStmt ? USE_ESCAPES : USE_DISCARDED);
+}
+
+void EscapeAnalyzer::visitOutputStmt(OutputStmt *stmt) {
+  visit(stmt->expr, USE_CONSUMED);
+}
+
+void EscapeAnalyzer::visitBlockStmt(BlockStmt *stmt) {
+  visitStmts(stmt->stmts);
+}
+
+void EscapeAnalyzer::visitIfStmt(IfStmt *stmt) {
+  // The value of an if statement is the value of the branch taken
+  bool last = lastStmt;
+  visit(stmt->condition, USE_CONSUMED);
+  lastStmt = last;
+  visitStmt(stmt->thenBranch);
+  if (stmt->elseBranch != nullptr) {
+    lastStmt = last;
+    visitStmt(stmt->elseBranch);
+  }
+}
+
+void EscapeAnalyzer::visitWhileStmt(WhileStmt *stmt) {
+  bool last = lastStmt;
+  visit(stmt->condition, USE_CONSUMED);
+  lastStmt = last;
+  visitStmt(stmt->body);
+}
+
+void EscapeAnalyzer::visitReturnStmt(ReturnStmt *stmt) {
+  if (stmt->value != nullptr) {
+    visit(stmt->value, USE_ESCAPES);
+  }
+}
+
+void EscapeAnalyzer::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+void EscapeAnalyzer::visitLambdaExpr(LambdaExpr *expr) {
+  if (!marking) {
+    analyzeBody(expr->body->stmts, &expr->parameters);
+  }
+}
+
+void EscapeAnalyzer::visitVarDeclExpr(VarDeclExpr *expr) {
+  std::string name = expr->name.getLexeme();
+  if (!marking) {
+    Name &info = scopes.back().names[name];
+    info.declarations++;
+    // The cell outlives the call
+    if (expr->boxed) {
+      info.escapes = true;
+    }
+  }
+  visit(expr->value, storeUse(name, use));
+}
+
+void EscapeAnalyzer::visitAssignExpr(AssignExpr *expr) {
+  std::string name = expr->name.getLexeme();
+  if (!marking) {
+    reference(name, false);
+  }
+  visit(expr->value, storeUse(name, use));
+}
+
+void EscapeAnalyzer::visitBinaryExpr(BinaryExpr *expr) {
+  if (marking) {
+    expr->escapes = use == USE_ESCAPES;
+  }
+  visit(expr->left, USE_CONSUMED);
+  visit(expr->right, USE_CONSUMED);
+}
+
+void EscapeAnalyzer::visitGrouping(Grouping *expr) {
+  visit(expr->contents, use);
+}
+
+void EscapeAnalyzer::visitUnaryExpr(UnaryExpr *expr) {
+  if (marking) {
+    expr->escapes = use == USE_ESCAPES;
+  }
+  visit(expr->right, USE_CONSUMED);
+}
+
+void EscapeAnalyzer::visitCallExpr(CallExpr *expr) {
+  // The callee may keep or return its arguments
+  visit(expr->callee, USE_ESCAPES);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    visit(expr->arguments[i], USE_ESCAPES);
+  }
+}
+
+void EscapeAnalyzer::visitIdentifier(Identifier *expr) {
+  if (!marking) {
+    reference(expr->token.getLexeme(), use == USE_ESCAPES);
+  }
+}
+
+void EscapeAnalyzer::visitRealNumber(RealNumber *expr) {}
+
+void EscapeAnalyzer::visitImaginaryNumber(ImaginaryNumber *expr) {}
+
+void EscapeAnalyzer::visitString(String *expr) {}
+
+void EscapeAnalyzer::visitBoolean(Boolean *expr) {}
+
+void EscapeAnalyzer::visitKeywordConstant(KeywordConstant *expr) {}
+
+/**
+ * Records a use of a name in the current top level statement.
+ */
+void EscapeAnalyzer::reference(std::string name, bool escapes) {
+  Name &info = scopes.back().names[name];
+  if (info.firstReference == -1 || stmtIndex < info.firstReference) {
+    info.firstReference = stmtIndex;
+  }
+  if (escapes) {
+    info.escapes = true;
+  }
+}
+
+/**
+ * Returns how the value assigned to a name is used, given how the value of
+ * the assignment itself is used.
+ */
+EscapeAnalyzer::Use EscapeAnalyzer::storeUse(std::string name,
+                                             Use assignmentUse) {
+  // Names aren't known to be contained until the first pass is done
+  if (marking && assignmentUse != USE_ESCAPES && isContained(name)) {
+    return USE_STORED;
+  }
+  return USE_ESCAPES;
+}
+
+/**
+ * Returns true if nothing stored in the name can outlive the call.
+ */
+bool EscapeAnalyzer::isContained(std::string name) {
+  Scope &scope = scopes.back();
+  if (!scope.isFunction) {
+    return false;
+  }
+  auto it = scope.names.find(name);
+  if (it == scope.names.end()) {
+    return false;
+  }
+  Name &info = it->second;
+  return info.declarations == 1 && info.declaredAt != -1 && !info.escapes &&
+         (info.firstReference == -1 || info.firstReference > info.declaredAt);
+}
+
+} // namespace napkin
@@ -0,0 +1,112 @@
+#ifndef NAPKIN_ESCAPE_H_
+#define NAPKIN_ESCAPE_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace napkin {
+
+/**
+ * Decides which operator results cannot outlive the closure call that computes
+ * them, so the interpreter can allocate them in the call's region (see
+ * CallRegion) instead of the garbage collected heap.
+ *
+ * A result doesn't escape if it is only consumed by another operator, a
+ * condition or an output statement, or if it is stored in a local of the
+ * function that never escapes itself. A local qualifies if it is declared
+ * once with ':=' at the top level of the function body, is not touched before
+ * that declaration, and is only ever read where a result wouldn't escape.
+ * Locals that closures capture never qualify (see VarDeclExpr::boxed).
+ *
+ * Everything else (return values, arguments, the value of a block, ...) is
+ * assumed to escape.
+ */
+class EscapeAnalyzer : public ASTVisitor<void> {
+public:
+  EscapeAnalyzer();
+
+  void analyze(std::vector<Stmt *> stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  /**
+   * What happens to the value of the expression being visited.
+   */
+  enum Use {
+    USE_ESCAPES,   // may outlive the call
+    USE_CONSUMED,  // read by an operator, condition or output statement
+    USE_DISCARDED, // thrown away (e.g. a statement in the middle of a block)
+    USE_STORED     // stored in a local that doesn't escape
+  };
+
+  /**
+   * What is known about a name used in a function.
+   */
+  struct Name {
+    unsigned long declarations = 0;
+    // Index of the top level statement declaring the name, or -1
+    long declaredAt = -1;
+    // Index of the first top level statement referring to the name
+    long firstReference = -1;
+    bool escapes = false;
+  };
+
+  /**
+   * A function body (or the program itself) being analyzed.
+   */
+  struct Scope {
+    bool isFunction;
+    std::unordered_map<std::string, Name> names;
+  };
+
+  void analyzeBody(std::vector<Stmt *> &stmts,
+                   std::vector<Identifier *> *parameters);
+  void visitStmts(std::vector<Stmt *> &stmts);
+  void visit(Expr *expr, Use t_use);
+  void reference(std::string name, bool escapes);
+  Use storeUse(std::string name, Use assignmentUse);
+  bool isContained(std::string name);
+
+  std::vector<Scope> scopes;
+
+  // The first pass gathers what is known about names, the second one marks
+  // the operators whose results don't escape
+  bool marking;
+  // How the value of the expression being visited is used
+  Use use;
+  // True while visiting the last statement of a block
+  bool lastStmt;
+  // Nesting of blocks inside the current function body
+  unsigned long blockDepth;
+  // Index of the top level statement being visited
+  long stmtIndex;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,114 @@
+#include "feedback.h"
+
+namespace napkin {
+
+unsigned long TypeFeedback::specializedReal = 0;
+unsigned long TypeFeedback::specializedComplex = 0;
+unsigned long TypeFeedback::generic = 0;
+unsigned long TypeFeedback::deoptimized = 0;
+
+/**
+ * Operands that can't be specialized on are passed as SPECIALIZATION_GENERIC.
+ */
+void TypeFeedback::observe(Specialization operands) {
+  if (operands == SPECIALIZATION_GENERIC ||
+      (observations != 0 && operands != observed)) {
+    specialization = SPECIALIZATION_GENERIC;
+    generic++;
+    return;
+  }
+  observed = operands;
+  observations++;
+  if (observations < WARMUP) {
+    return;
+  }
+  specialization = operands;
+  if (operands == SPECIALIZATION_REAL) {
+    specializedReal++;
+  } else {
+    specializedComplex++;
+  }
+}
+
+void TypeFeedback::deoptimize() {
+  if (specialization == SPECIALIZATION_REAL) {
+    specializedReal--;
+  } else {
+    specializedComplex--;
+  }
+  specialization = SPECIALIZATION_GENERIC;
+  generic++;
+  deoptimized++;
+}
+
+/**
+ * Prints how many operator sites ended up in each state.
+ */
+void TypeFeedback::printStats(std::ostream &out) {
+  out << "specialized operator sites: " << specializedReal << " real, "
+      << specializedComplex << " complex" << std::endl;
+  out << "generic operator sites: " << generic << " (" << deoptimized
+      << " deoptimized)" << std::endl;
+}
+
+/**
+ * Returns the operand types a binary operator can be specialized on.
+ * Arithmetic is specialized on real and complex numbers, exponentiation and
+ * comparisons on real numbers only.
+ */
+Specialization operandTypes(TokenType _operator, Value left, Value right) {
+  switch (_operator) {
+  case TOKEN_PLUS:
+  case TOKEN_MINUS:
+  case TOKEN_STAR:
+  case TOKEN_SLASH:
+    if (areComplexNumbers(left, right)) {
+      return SPECIALIZATION_COMPLEX;
+    }
+    // fall through
+  case TOKEN_STAR_STAR:
+  case TOKEN_LESS:
+  case TOKEN_LESS_EQUAL:
+  case TOKEN_GREATER:
+  case TOKEN_GREATER_EQUAL:
+  case TOKEN_EQUAL_EQUAL:
+  case TOKEN_BANG_EQUAL:
+    if (areRealNumbers(left, right)) {
+      return SPECIALIZATION_REAL;
+    }
+    return SPECIALIZATION_GENERIC;
+  default:
+    return SPECIALIZATION_GENERIC;
+  }
+}
+
+/**
+ * Fast path of a binary operator specialized on complex numbers. Computes the
+ * same operations, in the same order, as the generic operators do for two
+ * complex numbers, so the results are identical down to the sign of NaNs.
+ */
+Value operateComplex(TokenType _operator, NComplexNumber *left,
+                     NComplexNumber *right) {
+  switch (_operator) {
+  case TOKEN_PLUS:
+    return Value(new NComplexNumber(left->re + right->re, left->im + right->im));
+  case TOKEN_MINUS:
+    // Like nSubtract, which adds the negated right operand: the sign of a NaN
+    // depends on it
+    return Value(
+        new NComplexNumber(left->re + -right->re, left->im + -right->im));
+  case TOKEN_STAR:
+    return Value(new NComplexNumber(left->re * right->re - left->im * right->im,
+                                    left->re * right->im + left->im * right->re));
+  case TOKEN_SLASH: {
+    double divisor = pow(right->re, 2) + pow(right->im, 2);
+    double re = (left->re * right->re + left->im * right->im) / divisor;
+    double im = (-(left->re * right->im) + (right->re * left->im)) / divisor;
+    return Value(new NComplexNumber(re, im));
+  }
+  default:
+    throw ImplementationException("operator can't be specialized.");
+  }
+}
+
+} // namespace napkin
@@ -0,0 +1,103 @@
+#ifndef NAPKIN_FEEDBACK_H_
+#define NAPKIN_FEEDBACK_H_
+
+#include <cstdint>
+#include <ostream>
+
+#include "nobject.h"
+#include "noperator.h"
+#include "token.h"
+#include "value.h"
+
+namespace napkin {
+
+/**
+ * Operand types an operator node can be specialized on.
+ */
+enum Specialization : uint8_t {
+  // Still warming up
+  SPECIALIZATION_NONE,
+  // Every operand is a real number
+  SPECIALIZATION_REAL,
+  // Every operand is a complex number
+  SPECIALIZATION_COMPLEX,
+  // Saw mixed or other types: always takes the generic path
+  SPECIALIZATION_GENERIC
+};
+
+/**
+ * Type feedback of a BinaryExpr or UnaryExpr (see Interpreter::visitBinaryExpr).
+ * The node records the types of its operands while it warms up. Once it has
+ * seen the same types WARMUP times in a row, it specializes on them and
+ * evaluates with a fast path guarded by a type check. Seeing other types
+ * first, or failing the guard later on, makes it generic for good.
+ */
+class TypeFeedback {
+public:
+  TypeFeedback()
+      : specialization(SPECIALIZATION_NONE), observed(SPECIALIZATION_NONE),
+        observations(0){};
+
+  // Records the types of one evaluation's operands
+  void observe(Specialization operands);
+  // Called when the guard of the specialization fails
+  void deoptimize();
+
+  Specialization specialization;
+
+  static const unsigned int WARMUP = 8;
+
+  // Number of operator sites in each state, over the whole run
+  static unsigned long specializedReal;
+  static unsigned long specializedComplex;
+  static unsigned long generic;
+  static unsigned long deoptimized;
+  static void printStats(std::ostream &out);
+
+private:
+  // Types seen during the warmup
+  Specialization observed;
+  unsigned int observations;
+};
+
+// Specialization of operators, shared by the Interpreter and the
+// ClosureCompiler (see feedback.cpp)
+Specialization operandTypes(TokenType _operator, Value left, Value right);
+Value operateComplex(TokenType _operator, NComplexNumber *left,
+                     NComplexNumber *right);
+
+/**
+ * Fast path of a binary operator specialized on real numbers.
+ */
+inline Value operateReal(TokenType _operator, double left, double right) {
+  switch (_operator) {
+  case TOKEN_PLUS:
+    return Value(left + right);
+  case TOKEN_MINUS:
+    return Value(left - right);
+  case TOKEN_STAR:
+    return Value(left * right);
+  case TOKEN_SLASH:
+    return Value(left / right);
+  case TOKEN_STAR_STAR:
+    return nPower(Value(left), Value(right));
+  case TOKEN_LESS:
+    return Value::boolean(left < right);
+  case TOKEN_LESS_EQUAL:
+    return Value::boolean(left <= right);
+  case TOKEN_GREATER:
+    return Value::boolean(left > right);
+  case TOKEN_GREATER_EQUAL:
+    return Value::boolean(left >= right);
+  case TOKEN_EQUAL_EQUAL:
+    return Value::boolean(left == right);
+  case TOKEN_BANG_EQUAL:
+    return Value::boolean(left != right);
+  default:
+    throw ImplementationException("operator can't be specialized.");
+  }
+}
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,322 @@
+#include "folder.h"
+
+#include "noperator.h"
+
+namespace napkin {
+
+/**
+ * Returns the function implementing a binary operator, or nullptr.
+ */
+static Value (*binaryOperator(TokenType type))(Value, Value) {
+  switch (type) {
+  case TOKEN_PLUS:
+    return nAdd;
+  case TOKEN_MINUS:
+    return nSubtract;
+  case TOKEN_STAR:
+    return nMultiply;
+  case TOKEN_STAR_STAR:
+    return nPower;
+  case TOKEN_SLASH:
+    return nDivide;
+  case TOKEN_EQUAL_EQUAL:
+    return nLogicalEqual;
+  case TOKEN_BANG_EQUAL:
+    return nLogicalNotEqual;
+  case TOKEN_OR:
+    return nLogicalOr;
+  case TOKEN_AND:
+    return nLogicalAnd;
+  case TOKEN_LESS_EQUAL:
+    return nLessEqual;
+  case TOKEN_GREATER_EQUAL:
+    return nGreaterEqual;
+  case TOKEN_LESS:
+    return nLess;
+  case TOKEN_GREATER:
+    return nGreater;
+  default:
+    return nullptr;
+  }
+}
+
+/**
+ * Returns true if a value is the real number n.
+ */
+static bool isReal(Value value, double n) {
+  return value.isNumber() && value.asNumber() == n;
+}
+
+ConstantFolder::ConstantFolder(Arena *t_arena) : arena(t_arena) {
+  stmtResult = nullptr;
+  exprResult = nullptr;
+  constant = Value::undefined();
+  numeric = false;
+  numericNegation = nullptr;
+}
+
+void ConstantFolder::fold(std::vector<Stmt *> &stmts) {
+  foldStmts(stmts);
+}
+
+void ConstantFolder::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void ConstantFolder::visitExprStmt(ExprStmt *stmt) {
+  stmt->expr = foldExpr(stmt->expr);
+  stmtResult = stmt;
+}
+
+void ConstantFolder::visitOutputStmt(OutputStmt *stmt) {
+  stmt->expr = foldExpr(stmt->expr);
+  stmtResult = stmt;
+}
+
+void ConstantFolder::visitBlockStmt(BlockStmt *stmt) {
+  foldStmts(stmt->stmts);
+  stmtResult = stmt;
+}
+
+void ConstantFolder::visitIfStmt(IfStmt *stmt) {
+  stmt->condition = foldExpr(stmt->condition);
+  Value condition = constant;
+  stmt->thenBranch = foldStmt(stmt->thenBranch);
+  if (stmt->elseBranch != nullptr) {
+    stmt->elseBranch = foldStmt(stmt->elseBranch);
+  }
+  stmtResult = stmt;
+  if (condition.isUndefined()) {
+    return;
+  }
+
+  // The value of an if statement is the value of the branch taken
+  Stmt *taken = isTruthy(condition) ? stmt->thenBranch : stmt->elseBranch;
+  Stmt *skipped = isTruthy(condition) ? stmt->elseBranch : stmt->thenBranch;
+  if (skipped != nullptr && dynamic_cast<BlockStmt *>(skipped) == nullptr) {
+    return;
+  }
+  stmtResult = taken != nullptr ? taken : nothing();
+}
+
+/**
+ * Loops evaluate to nil, like empty blocks.
+ */
+void ConstantFolder::visitWhileStmt(WhileStmt *stmt) {
+  stmt->condition = foldExpr(stmt->condition);
+  Value condition = constant;
+  stmt->body = foldStmt(stmt->body);
+  stmtResult = stmt;
+  if (!condition.isUndefined() && !isTruthy(condition) &&
+      dynamic_cast<BlockStmt *>(stmt->body) != nullptr) {
+    stmtResult = nothing();
+  }
+}
+
+void ConstantFolder::visitReturnStmt(ReturnStmt *stmt) {
+  if (stmt->value != nullptr) {
+    stmt->value = foldExpr(stmt->value);
+  }
+  stmtResult = stmt;
+}
+
+void ConstantFolder::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+void ConstantFolder::visitLambdaExpr(LambdaExpr *expr) {
+  foldStmts(expr->body->stmts);
+  variable(expr, false);
+}
+
+void ConstantFolder::visitVarDeclExpr(VarDeclExpr *expr) {
+  expr->value = foldExpr(expr->value);
+  variable(expr, numeric);
+}
+
+void ConstantFolder::visitAssignExpr(AssignExpr *expr) {
+  expr->value = foldExpr(expr->value);
+  variable(expr, numeric);
+}
+
+void ConstantFolder::visitBinaryExpr(BinaryExpr *expr) {
+  TokenType type = expr->_operator.getTokenType();
+  expr->left = foldExpr(expr->left);
+  Value left = constant;
+  bool leftNumeric = numeric;
+  expr->right = foldExpr(expr->right);
+  Value right = constant;
+  bool rightNumeric = numeric;
+
+  Value (*op)(Value, Value) = binaryOperator(type);
+  if (op != nullptr && !left.isUndefined() && !right.isUndefined()) {
+    try {
+      Expr *folded = literal(op(left, right), expr->_operator);
+      if (folded != nullptr) {
+        exprResult = folded;
+        return;
+      }
+    } catch (RuntimeException &exception) {
+      // Reported if the operator ever runs
+    }
+  }
+
+  // Identities
+  if (leftNumeric && ((type == TOKEN_STAR && isReal(right, 1)) ||
+                      (type == TOKEN_SLASH && isReal(right, 1)) ||
+                      (type == TOKEN_MINUS && isReal(right, 0)))) {
+    variable(expr->left, true);
+    return;
+  }
+  if (rightNumeric && type == TOKEN_STAR && isReal(left, 1)) {
+    variable(expr->right, true);
+    return;
+  }
+
+  // Every arithmetic operator but "+" either fails or returns a number
+  variable(expr, type == TOKEN_MINUS || type == TOKEN_STAR ||
+                     type == TOKEN_STAR_STAR || type == TOKEN_SLASH);
+}
+
+void ConstantFolder::visitGrouping(Grouping *expr) {
+  // Leaves the contents' results in place
+  expr->contents = foldExpr(expr->contents);
+}
+
+void ConstantFolder::visitUnaryExpr(UnaryExpr *expr) {
+  TokenType type = expr->_operator.getTokenType();
+  expr->right = foldExpr(expr->right);
+  Value right = constant;
+  bool rightNumeric = numeric;
+
+  Value (*op)(Value) = nullptr;
+  switch (type) {
+  case TOKEN_MINUS:
+    op = nNegate;
+    break;
+  case TOKEN_J:
+    op = nJ;
+    break;
+  case TOKEN_BANG:
+  case TOKEN_NOT:
+    op = nNot;
+    break;
+  default:
+    break;
+  }
+  if (op != nullptr && !right.isUndefined()) {
+    try {
+      Expr *folded = literal(op(right), expr->_operator);
+      if (folded != nullptr) {
+        exprResult = folded;
+        return;
+      }
+    } catch (RuntimeException &exception) {
+      // Reported if the operator ever runs
+    }
+  }
+
+  // -(-x) is x if x is a number
+  if (type == TOKEN_MINUS && expr->right == numericNegation) {
+    variable(numericNegation->right, true);
+    numericNegation = nullptr;
+    return;
+  }
+
+  variable(expr, type == TOKEN_MINUS || type == TOKEN_J);
+  numericNegation = type == TOKEN_MINUS && rightNumeric ? expr : nullptr;
+}
+
+void ConstantFolder::visitCallExpr(CallExpr *expr) {
+  expr->callee = foldExpr(expr->callee);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    expr->arguments[i] = foldExpr(expr->arguments[i]);
+  }
+  variable(expr, false);
+}
+
+void ConstantFolder::visitIdentifier(Identifier *expr) {
+  variable(expr, false);
+}
+
+void ConstantFolder::visitRealNumber(RealNumber *expr) {
+  exprResult = expr;
+  constant = expr->constant;
+  numeric = true;
+}
+
+void ConstantFolder::visitImaginaryNumber(ImaginaryNumber *expr) {
+  exprResult = expr;
+  constant = expr->constant;
+  numeric = true;
+}
+
+void ConstantFolder::visitString(String *expr) {
+  exprResult = expr;
+  constant = expr->constant;
+  numeric = false;
+}
+
+void ConstantFolder::visitBoolean(Boolean *expr) {
+  exprResult = expr;
+  constant = expr->constant;
+  numeric = false;
+}
+
+void ConstantFolder::visitKeywordConstant(KeywordConstant *expr) {
+  exprResult = expr;
+  constant = expr->constant;
+  numeric = isNumeric(constant);
+}
+
+Stmt *ConstantFolder::foldStmt(Stmt *stmt) {
+  stmt->accept(this);
+  return stmtResult;
+}
+
+/**
+ * Also sets constant and numeric for the returned node.
+ */
+Expr *ConstantFolder::foldExpr(Expr *expr) {
+  expr->accept(this);
+  return exprResult;
+}
+
+void ConstantFolder::foldStmts(std::vector<Stmt *> &stmts) {
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    stmts[i] = foldStmt(stmts[i]);
+  }
+}
+
+void ConstantFolder::variable(Expr *expr, bool t_numeric) {
+  exprResult = expr;
+  constant = Value::undefined();
+  numeric = t_numeric;
+}
+
+/**
+ * The token is the operator the value was computed by, which locates the
+ * literal in the source.
+ */
+Expr *ConstantFolder::literal(Value value, Token &token) {
+  Expr *folded = nullptr;
+  if (value.isNumber()) {
+    folded = arena->make<RealNumber>(token, value.asNumber());
+  } else if (value.getType() == N_COMPLEX_NUMBER) {
+    NComplexNumber *number = (NComplexNumber *)value.asObject();
+    folded = arena->make<ImaginaryNumber>(token, number->re, number->im);
+  } else if (value.getType() == N_BOOLEAN) {
+    folded = arena->make<Boolean>(token, value.asBoolean());
+  } else {
+    return nullptr;
+  }
+  constant = value;
+  numeric = isNumeric(value);
+  return folded;
+}
+
+Stmt *ConstantFolder::nothing() {
+  return arena->make<BlockStmt>(std::vector<Stmt *>());
+}
+
+} // namespace napkin
@@ -0,0 +1,88 @@
+#ifndef NAPKIN_FOLDER_H_
+#define NAPKIN_FOLDER_H_
+
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+#include "arena.h"
+#include "value.h"
+
+namespace napkin {
+
+/**
+ * Simplifies the AST right after parsing:
+ * - operators whose operands are all constants are evaluated once and
+ *   replaced by a literal, if the result is a real or complex number or a
+ *   boolean (e.g. "pi/2", "j1*0", "1 < 2"). Operators that fail on their
+ *   constants are left alone so the error is reported when they run.
+ * - parentheses are dropped
+ * - "x * 1", "1 * x", "x / 1", "x - 0" and "-(-x)" become "x" when x is
+ *   always a number (the result of an arithmetic operator other than "+",
+ *   which also concatenates strings). "x + 0" is kept since -0 + 0 is 0.
+ * - if statements with a constant condition are replaced by the branch
+ *   taken, and while loops whose condition is constantly false are removed.
+ *   A branch that isn't a block is only removed if it isn't taken, since it
+ *   may declare variables in the enclosing scope.
+ *
+ * Literal constants are shared by every evaluation (see RealNumber), so the
+ * folded expressions don't allocate anymore either.
+ */
+class ConstantFolder : public ASTVisitor<void> {
+public:
+  // Folded literals are created in the arena that owns the AST
+  ConstantFolder(Arena *t_arena);
+
+  void fold(std::vector<Stmt *> &stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  // Return the node to use in place of the one given
+  Stmt *foldStmt(Stmt *stmt);
+  Expr *foldExpr(Expr *expr);
+  void foldStmts(std::vector<Stmt *> &stmts);
+
+  // Sets the result of visiting a node that isn't a constant
+  void variable(Expr *expr, bool t_numeric);
+  // Returns a literal for a value, or nullptr if it has none
+  Expr *literal(Value value, Token &token);
+  // An empty block, which evaluates to nil
+  Stmt *nothing();
+
+  Arena *arena;
+
+  // Results of the last visit
+  Stmt *stmtResult;
+  Expr *exprResult;
+  // Value of exprResult if it is a constant, undefined otherwise
+  Value constant;
+  // True if exprResult always evaluates to a real or complex number
+  bool numeric;
+  // The last negation visited, if it negates a number
+  UnaryExpr *numericNegation;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,341 @@
+#include "heap.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "profiler.h"
+
+namespace napkin {
+
+// Default minimum heap size before the first collection (1 MiB)
+static const std::size_t DEFAULT_THRESHOLD = 1 << 20;
+// Most memory the call regions may hold at once (1 MiB)
+static const std::size_t REGION_LIMIT = 1 << 20;
+
+/**
+ * Returns the heap shared by every HeapObject.
+ */
+Heap *heap() {
+  static Heap instance;
+  return &instance;
+}
+
+void *HeapObject::operator new(std::size_t size) {
+  return heap()->allocate(size);
+}
+
+void HeapObject::operator delete(void *pointer) {
+  heap()->deallocate(pointer);
+}
+
+Heap::Heap() : region(REGION_LIMIT) {
+  objects = nullptr;
+  objectCount = 0;
+  bytesAllocated = 0;
+  threshold = DEFAULT_THRESHOLD;
+  nextCollection = threshold;
+  collectionCount = 0;
+
+  for (std::size_t size = POOL_GRANULARITY; size <= MAX_POOLED_SIZE;
+       size += POOL_GRANULARITY) {
+    pools.push_back(new Pool(size));
+  }
+  largeAllocations = 0;
+  regionDepth = 0;
+  regionAllocation = false;
+  profiler = nullptr;
+  allocationSite = 0;
+}
+
+void Heap::setThreshold(std::size_t bytes) {
+  threshold = bytes;
+  nextCollection = std::max(threshold, 2 * bytesAllocated);
+}
+
+std::size_t Heap::getThreshold() {
+  return threshold;
+}
+
+/**
+ * Returns true if the heap has grown enough that a collection should be run at
+ * the next safe point.
+ */
+/**
+ * Marks everything reachable from the root sources and frees everything else.
+ * Returns the number of objects freed.
+ */
+std::size_t Heap::collect() {
+  for (unsigned long i = 0; i < rootSources.size(); i++) {
+    rootSources[i]->markRoots(this);
+  }
+  for (auto it = pinned.begin(); it != pinned.end(); ++it) {
+    mark(it->first);
+  }
+  traceReferences();
+  std::size_t freed = sweep();
+  // Region objects aren't swept, but they can be marked
+  std::vector<HeapObject *> &regionObjects = region.getObjects();
+  for (unsigned long i = 0; i < regionObjects.size(); i++) {
+    headerOf(regionObjects[i])->marked = false;
+  }
+
+  nextCollection = std::max(threshold, 2 * bytesAllocated);
+  collectionCount++;
+  return freed;
+}
+
+void Heap::addRootSource(RootSource *source) {
+  rootSources.push_back(source);
+}
+
+void Heap::removeRootSource(RootSource *source) {
+  rootSources.erase(
+      std::remove(rootSources.begin(), rootSources.end(), source),
+      rootSources.end());
+}
+
+/**
+ * Keeps an object alive even if nothing else refers to it (e.g. constants
+ * stored in the AST).
+ */
+void Heap::pin(HeapObject *object) {
+  pinned[object]++;
+}
+
+void Heap::unpin(HeapObject *object) {
+  auto it = pinned.find(object);
+  if (it != pinned.end() && --it->second == 0) {
+    pinned.erase(it);
+  }
+}
+
+/**
+ * Marks an object as reachable. Its references are traced later so that deep
+ * object graphs don't overflow the C++ stack.
+ */
+void Heap::mark(HeapObject *object) {
+  if (object == nullptr) {
+    return;
+  }
+  Header *header = headerOf(object);
+  if (header->marked) {
+    return;
+  }
+  header->marked = true;
+  grayStack.push_back(object);
+}
+
+std::size_t Heap::getBytesAllocated() {
+  return bytesAllocated;
+}
+
+std::size_t Heap::getObjectCount() {
+  return objectCount;
+}
+
+std::size_t Heap::getCollectionCount() {
+  return collectionCount;
+}
+
+std::size_t Heap::getPoolCount() {
+  return pools.size();
+}
+
+Pool *Heap::getPool(std::size_t sizeClass) {
+  return pools[sizeClass];
+}
+
+std::size_t Heap::getLargeAllocations() {
+  return largeAllocations;
+}
+
+/**
+ * Allocates memory for a heap object and links it into the list of objects.
+ * Small objects come from the pool for their size class.
+ */
+void *Heap::allocate(std::size_t size) {
+  std::size_t total = sizeof(Header) + size;
+  if (regionAllocation && regionDepth != 0) {
+    Header *header = (Header *)region.allocate(total);
+    if (header != nullptr) {
+      header->prev = nullptr;
+      header->next = nullptr;
+      header->size = total;
+      header->marked = false;
+      header->inRegion = true;
+      header->site = allocationSite;
+      region.addObject((HeapObject *)(header + 1));
+      if (profiler != nullptr) {
+        profiler->recordAllocation(allocationSite, total);
+      }
+      return header + 1;
+    }
+  }
+
+  Header *header;
+  if (total <= MAX_POOLED_SIZE) {
+    Pool *pool = pools[(total - 1) / POOL_GRANULARITY];
+    total = pool->getBlockSize();
+    header = (Header *)pool->allocate();
+  } else {
+    header = (Header *)std::malloc(total);
+    if (header == nullptr) {
+      throw std::bad_alloc();
+    }
+    largeAllocations++;
+  }
+  header->prev = nullptr;
+  header->next = objects;
+  header->size = total;
+  header->marked = false;
+  header->inRegion = false;
+  header->site = allocationSite;
+  if (objects != nullptr) {
+    objects->prev = header;
+  }
+  objects = header;
+  if (profiler != nullptr) {
+    profiler->recordAllocation(allocationSite, total);
+  }
+
+  objectCount++;
+  bytesAllocated += total;
+  return header + 1;
+}
+
+/**
+ * Unlinks a heap object from the list of objects and frees its memory.
+ */
+void Heap::deallocate(void *pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+  Header *header = (Header *)pointer - 1;
+  if (header->prev != nullptr) {
+    header->prev->next = header->next;
+  } else {
+    objects = header->next;
+  }
+  if (header->next != nullptr) {
+    header->next->prev = header->prev;
+  }
+
+  objectCount--;
+  bytesAllocated -= header->size;
+  if (header->size <= MAX_POOLED_SIZE) {
+    pools[(header->size - 1) / POOL_GRANULARITY]->deallocate(header);
+  } else {
+    std::free(header);
+  }
+}
+
+/**
+ * Opens a new innermost region. Returns the mark to release it with.
+ */
+Region::Mark Heap::enterRegion() {
+  regionDepth++;
+  return region.getMark();
+}
+
+/**
+ * Destroys everything allocated in the region since it was opened.
+ */
+void Heap::leaveRegion(Region::Mark mark) {
+  if (profiler != nullptr) {
+    std::vector<HeapObject *> &regionObjects = region.getObjects();
+    for (unsigned long i = mark.objects; i < regionObjects.size(); i++) {
+      profiler->recordDeath(regionObjects[i]->getTypeName(),
+                            headerOf(regionObjects[i])->size);
+    }
+  }
+  region.release(mark);
+  regionDepth--;
+}
+
+bool Heap::setRegionAllocation(bool enabled) {
+  bool previous = regionAllocation;
+  regionAllocation = enabled;
+  return previous;
+}
+
+Region *Heap::getRegion() {
+  return &region;
+}
+
+/**
+ * Returns true if an object will be destroyed when its region is released.
+ */
+bool Heap::isInRegion(HeapObject *object) {
+  return headerOf(object)->inRegion;
+}
+
+void Heap::setProfiler(HeapProfiler *t_profiler) {
+  profiler = t_profiler;
+}
+
+unsigned int Heap::setAllocationSite(unsigned int site) {
+  unsigned int previous = allocationSite;
+  allocationSite = site;
+  return previous;
+}
+
+/**
+ * Objects are only reported to the profiler when they die, so the ones still
+ * alive are reported separately before it prints a profile.
+ */
+void Heap::profileLiveObjects() {
+  if (profiler == nullptr) {
+    return;
+  }
+  for (Header *header = objects; header != nullptr; header = header->next) {
+    profiler->recordLive(((HeapObject *)(header + 1))->getTypeName(),
+                         header->size);
+  }
+  std::vector<HeapObject *> &regionObjects = region.getObjects();
+  for (unsigned long i = 0; i < regionObjects.size(); i++) {
+    profiler->recordLive(regionObjects[i]->getTypeName(),
+                         headerOf(regionObjects[i])->size);
+  }
+}
+
+Heap::Header *Heap::headerOf(HeapObject *object) {
+  return (Header *)object - 1;
+}
+
+/**
+ * Traces the references of every marked object until there are none left.
+ */
+void Heap::traceReferences() {
+  while (!grayStack.empty()) {
+    HeapObject *object = grayStack.back();
+    grayStack.pop_back();
+    object->trace(this);
+  }
+}
+
+/**
+ * Frees every unmarked object and clears the marks of the survivors.
+ */
+std::size_t Heap::sweep() {
+  std::size_t freed = 0;
+  Header *header = objects;
+  while (header != nullptr) {
+    Header *next = header->next;
+    if (header->marked) {
+      header->marked = false;
+    } else {
+      HeapObject *object = (HeapObject *)(header + 1);
+      if (profiler != nullptr) {
+        profiler->recordDeath(object->getTypeName(), header->size);
+      }
+      // The destructor runs first, then operator delete unlinks the header
+      delete object;
+      freed++;
+    }
+    header = next;
+  }
+  return freed;
+}
+
+} // namespace napkin
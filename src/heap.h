@@ -0,0 +1,198 @@
+#ifndef NAPKIN_HEAP_H_
+#define NAPKIN_HEAP_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "pool.h"
+#include "region.h"
+
+/**
+ * Garbage collected heap for napkin runtime objects.
+ */
+
+namespace napkin {
+
+class Heap;
+class HeapProfiler;
+
+/**
+ * Base class for everything owned by the garbage collector.
+ * Allocating a HeapObject with "new" links it into the heap. It is then freed
+ * by the collector once it is no longer reachable from any root, so heap
+ * objects must never be deleted explicitly.
+ * Objects constructed on the C++ stack are never linked into the heap.
+ */
+class HeapObject {
+public:
+  virtual ~HeapObject() {}
+
+  // Marks every heap object directly referenced by this object
+  virtual void trace(Heap *heap) {}
+
+  // Name of the kind of object, used by the heap profiler
+  virtual const char *getTypeName() { return "object"; }
+
+  static void *operator new(std::size_t size);
+  static void operator delete(void *pointer);
+};
+
+/**
+ * Anything that holds references to heap objects which are not reachable from
+ * other heap objects (e.g. the interpreter's current environment).
+ */
+class RootSource {
+public:
+  virtual void markRoots(Heap *heap) = 0;
+};
+
+/**
+ * Mark-and-sweep collector.
+ * Collections never happen in the middle of an allocation. Instead, the heap
+ * requests one once it has grown past its trigger and the interpreter runs it
+ * at its next safe point. After each collection the trigger is set to twice
+ * the surviving heap size, but never below the threshold.
+ *
+ * Small objects are carved from per size class pools, so the steady churn of
+ * temporaries (complex numbers, strings, environments) recycles memory freed
+ * by the previous collection instead of going through malloc/free.
+ */
+class Heap {
+public:
+  Heap();
+
+  // Smallest heap size (in bytes) at which a collection is requested
+  void setThreshold(std::size_t bytes);
+  std::size_t getThreshold();
+
+  // Checked at every safe point, so kept inline
+  bool collectionRequested() { return bytesAllocated >= nextCollection; }
+  // Runs a full collection and returns the number of objects freed
+  std::size_t collect();
+
+  void addRootSource(RootSource *source);
+  void removeRootSource(RootSource *source);
+
+  // Pinned objects are roots until they are unpinned as often as pinned
+  void pin(HeapObject *object);
+  void unpin(HeapObject *object);
+
+  // Used by RootSources and HeapObject::trace
+  void mark(HeapObject *object);
+
+  std::size_t getBytesAllocated();
+  std::size_t getObjectCount();
+  std::size_t getCollectionCount();
+
+  // Size class pools (index i serves allocations of up to
+  // (i + 1) * POOL_GRANULARITY bytes, headers included)
+  std::size_t getPoolCount();
+  Pool *getPool(std::size_t sizeClass);
+  // Number of allocations too large for any pool
+  std::size_t getLargeAllocations();
+
+  static const std::size_t POOL_GRANULARITY = 16;
+  static const std::size_t MAX_POOLED_SIZE = 256;
+
+  // Used by HeapObject::operator new and delete
+  void *allocate(std::size_t size);
+  void deallocate(void *pointer);
+
+  // Closure calls open a region that is released when they return (see
+  // CallRegion). While region allocation is enabled, new objects are placed
+  // in the innermost open region if it has room.
+  Region::Mark enterRegion();
+  void leaveRegion(Region::Mark mark);
+  // Returns the previous setting
+  bool setRegionAllocation(bool enabled);
+  Region *getRegion();
+  bool isInRegion(HeapObject *object);
+
+  // Allocation profiling (disabled while the profiler is nullptr). New
+  // objects are attributed to the current allocation site.
+  void setProfiler(HeapProfiler *t_profiler);
+  HeapProfiler *getProfiler() { return profiler; }
+  // Returns the previous site
+  unsigned int setAllocationSite(unsigned int site);
+  // Reports the type of every object still alive to the profiler
+  void profileLiveObjects();
+
+private:
+  /**
+   * Bookkeeping stored in front of every heap object.
+   */
+  struct Header {
+    Header *prev;
+    Header *next;
+    std::size_t size;
+    bool marked;
+    // Region objects aren't linked into the list of objects
+    bool inRegion;
+    // Where the object was allocated (see HeapProfiler)
+    unsigned int site;
+  };
+
+  static Header *headerOf(HeapObject *object);
+
+  // Doubly linked list of every live allocation
+  Header *objects;
+  std::size_t objectCount;
+
+  // Bytes currently allocated (including headers)
+  std::size_t bytesAllocated;
+  // Heap size at which the next collection is requested
+  std::size_t nextCollection;
+  std::size_t threshold;
+  std::size_t collectionCount;
+
+  std::vector<Pool *> pools;
+  std::size_t largeAllocations;
+
+  Region region;
+  unsigned long regionDepth;
+  bool regionAllocation;
+
+  HeapProfiler *profiler;
+  unsigned int allocationSite;
+
+  std::vector<RootSource *> rootSources;
+  std::unordered_map<HeapObject *, unsigned long> pinned;
+  // Objects that have been marked but not traced yet
+  std::vector<HeapObject *> grayStack;
+
+  void traceReferences();
+  std::size_t sweep();
+};
+
+// The heap used by every HeapObject
+Heap *heap();
+
+/**
+ * Opens a region for the lifetime of a closure call.
+ */
+class CallRegion {
+public:
+  CallRegion() : mark(heap()->enterRegion()){};
+  ~CallRegion() { heap()->leaveRegion(mark); }
+
+private:
+  Region::Mark mark;
+};
+
+/**
+ * Enables (or disables) region allocation for its lifetime.
+ */
+class RegionAllocation {
+public:
+  RegionAllocation(bool t_enabled)
+      : previous(heap()->setRegionAllocation(t_enabled)){};
+  ~RegionAllocation() { heap()->setRegionAllocation(previous); }
+
+private:
+  bool previous;
+};
+
+} // namespace napkin
+
+#endif
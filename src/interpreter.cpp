@@ -1,17 +1,43 @@
 #include "interpreter.h"
 
+#include <sys/resource.h>
+
 namespace napkin {
 
 Interpreter::Interpreter(bool repl) {
   globals = new Environment;
   // Define default global variables
-  globals->bind("millis", new MillisFunction);
-  globals->bind("getline", new GetlineFunction);
-  globals->bind("exit", new ExitFunction);
-  globals->bind("exit_status", new ExitStatusFunction);
+  defineNativeFunctions(globals);
   environment = globals;
+  returnValue = Value();
+  returning = false;
+  tailCallSite = nullptr;
+  tailCalling = false;
+  loopRuns = 0;
+  jit = false;
+  memoize = true;
+  memoEpoch = 0;
+  sideEffects = 0;
+
+  // Napkin calls recurse on the C++ stack, from about here
+  char base;
+  stackBase = &base;
+  struct rlimit limit;
+  stackLimit = DEFAULT_STACK_LIMIT;
+  if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+      limit.rlim_cur < stackLimit) {
+    stackLimit = limit.rlim_cur;
+  }
+  // Small stacks keep half of themselves as the margin
+  stackLimit = stackLimit > STACK_MARGIN ? stackLimit - STACK_MARGIN
+                                         : stackLimit / 2;
 
   this->repl = repl;
+  heap()->addRootSource(this);
+}
+
+Interpreter::~Interpreter() {
+  heap()->removeRootSource(this);
 }
 
 /**
@@ -20,13 +46,26 @@ Interpreter::Interpreter(bool repl) {
 void Interpreter::interpret(std::vector<Stmt *> stmts) {
   for (unsigned int i = 0; i < stmts.size(); i++) {
     visitStmt(stmts[i]);
+    if (returning) {
+      // Returned from outside of a function
+      throw ReturnException(takeReturnValue());
+    }
   }
 }
 
 /**
  * Executes a statement.
  */
-NObject *Interpreter::visitStmt(Stmt *stmt) {
+Value Interpreter::visitStmt(Stmt *stmt) {
+  // Statement boundaries are the interpreter's safe points: every live value
+  // is reachable from an environment or one of the other roots here
+  if (heap()->collectionRequested()) {
+    collectGarbage();
+  }
+  if (heap()->getProfiler() != nullptr) {
+    heap()->getProfiler()->poll();
+  }
+  budget.step();
   // Make the statement call its specific visit method
   return stmt->accept(this);
 }
@@ -34,13 +73,13 @@ NObject *Interpreter::visitStmt(Stmt *stmt) {
 /**
  * Executes an expression statement.
  */
-NObject *Interpreter::visitExprStmt(ExprStmt *stmt) {
+Value Interpreter::visitExprStmt(ExprStmt *stmt) {
   // If running in repl, print the result
   // Else, just evaluate that expression
   if (repl) {
-    NObject *result = stmt->expr->accept(this);
-    if (result != nullptr) {
-      std::cout << result->repr() << std::endl;
+    Value result = stmt->expr->accept(this);
+    if (!result.isNull()) {
+      std::cout << result.repr() << std::endl;
     }
     return result;
   } else {
@@ -51,27 +90,34 @@ NObject *Interpreter::visitExprStmt(ExprStmt *stmt) {
 /**
  * Executes an "output" statement.
  */
-NObject *Interpreter::visitOutputStmt(OutputStmt *stmt) {
+Value Interpreter::visitOutputStmt(OutputStmt *stmt) {
   // Evaluate the statement to the right of "output"
-  NObject *result = stmt->expr->accept(this);
-  if (result != nullptr) {
+  Value result = stmt->expr->accept(this);
+  if (!result.isNull()) {
     // Output the string representation of result
-    std::cout << result->repr() << std::endl;
+    std::cout << result.repr() << std::endl;
   } else {
     std::cout << "nil" << std::endl;
   }
-  return nullptr;
+  return Value();
 }
 
 /**
  * Visits a block statement.
  * Creates a new empty environment with the current environment as the enclosing
  * environment and passes this new environment to executeBlockStmt
+ * Blocks without variables run in the current environment.
  */
-NObject *Interpreter::visitBlockStmt(BlockStmt *stmt) {
+Value Interpreter::visitBlockStmt(BlockStmt *stmt) {
+  if (!stmt->needsFrame) {
+    return executeBlockStmt(stmt, environment);
+  }
   // Constructs a new environment with the current environment as the enclosing
   // environment
-  return executeBlockStmt(stmt, new Environment(environment));
+  Environment *frame = acquireFrame(environment, stmt->slotCount);
+  Value value = executeBlockStmt(stmt, frame);
+  releaseFrame(frame);
+  return value;
 }
 
 /**
@@ -80,43 +126,45 @@ NObject *Interpreter::visitBlockStmt(BlockStmt *stmt) {
  * @param environment The environment under which to execute the contents of the
  *        block statement.
  */
-NObject *Interpreter::executeBlockStmt(BlockStmt *stmt,
+Value Interpreter::executeBlockStmt(BlockStmt *stmt,
                                        Environment *innerEnvironment) {
   // Remembers the current environment
   Environment *previous = this->environment;
+  environmentStack.push_back(previous);
 
   // Sets the current environement to the inner environment
   this->environment = innerEnvironment;
 
-  // Executes all statements in the block
+  // Executes all statements in the block, stopping early at a return
   // Captures the value of the last statement
   // Note: we must catch exceptions here to ensure the previous environement is
-  // restored. Especially for ReturnExceptions
-  // Note: we must initialize value to nullptr in case there are no statements
+  // restored when a runtime error unwinds through the block
+  // Note: we must initialize value to null in case there are no statements
   // in stmt->stmts to execute and the assignment inside the for loop never runs
-  NObject *value = nullptr;
+  Value value;
   try {
     for (unsigned int i = 0; i < stmt->stmts.size(); i++) {
       value = visitStmt(stmt->stmts[i]);
+      if (returning) {
+        break;
+      }
     }
-  }
-  catch (ReturnException exception) {
+  } catch (...) {
     this->environment = previous;
-    throw std::move(exception);
-  } catch (RuntimeException exception) {
-    this->environment = previous;
-    throw std::move(exception);
+    environmentStack.pop_back();
+    throw;
   }
 
   // Restores the previous environment
   this->environment = previous;
+  environmentStack.pop_back();
   return value;
 }
 
 /**
  * Executes if statement.
  */
-NObject *Interpreter::visitIfStmt(IfStmt *stmt) {
+Value Interpreter::visitIfStmt(IfStmt *stmt) {
   // Checks if condition evaluates to true
   if (isTruthy(stmt->condition->accept(this))) {
     return stmt->thenBranch->accept(this); 
@@ -124,35 +172,56 @@ NObject *Interpreter::visitIfStmt(IfStmt *stmt) {
     // If there is an else clause, execute it
     return stmt->elseBranch->accept(this); 
   }
-  return nullptr;
+  return Value();
 }
 
 /**
  * Executes while statement.
+ * Each run of the loop computes its invariant operators anew (see
+ * LoopInvariant). Runs of the same loop nest when its function recurses.
  */
-NObject *Interpreter::visitWhileStmt(WhileStmt *stmt) {
+Value Interpreter::visitWhileStmt(WhileStmt *stmt) {
+  unsigned long enclosingRun = stmt->run;
+  stmt->run = ++loopRuns;
+  runningLoops.push_back(stmt);
+
   // While the condition evaluates to true, execute the body
-  while (isTruthy(stmt->condition->accept(this))) {
-    stmt->body->accept(this);
+  try {
+    while (isTruthy(stmt->condition->accept(this))) {
+      stmt->body->accept(this);
+      if (returning) {
+        break;
+      }
+      // Counted even if the body has no statements
+      budget.step();
+    }
+  } catch (...) {
+    endLoopRun(stmt, enclosingRun);
+    throw;
   }
-  return nullptr;
+  endLoopRun(stmt, enclosingRun);
+  return Value();
 }
 
 /**
  * Executes return statement.
- * TODO
+ * Doesn't unwind anything itself: it raises the returning signal, which makes
+ * the enclosing blocks and loops stop early until the call picks up the value
+ * (see NClosure::call).
  */
-NObject *Interpreter::visitReturnStmt(ReturnStmt *stmt) {
-  NObject *value = nullptr;
+Value Interpreter::visitReturnStmt(ReturnStmt *stmt) {
+  Value value;
   if (stmt->value != nullptr) {
     // Evaluate the value to the right of "return"
     value = stmt->value->accept(this);
   }
-  // Should be caught at callsite
-  throw ReturnException(value);
+  // Keep the value reachable until the callsite picks it up
+  returnValue = value;
+  returning = true;
+  return value;
 }
 
-NObject *Interpreter::visitExpr(Expr *expr) {
+Value Interpreter::visitExpr(Expr *expr) {
   // Make the expression call its specific visit method
   return expr->accept(this);
 }
@@ -160,33 +229,94 @@ NObject *Interpreter::visitExpr(Expr *expr) {
 /**
  * Creates new NClosure object
  */
-NObject *Interpreter::visitLambdaExpr(LambdaExpr *expr) {
-  return new NClosure(expr, this->environment);
+Value Interpreter::visitLambdaExpr(LambdaExpr *expr) {
+  AllocationSite site(expr->arrow);
+  return Value(new NClosure(expr, this->environment));
 }
 
-NObject *Interpreter::visitVarDeclExpr(VarDeclExpr *expr) {
-  NObject *value = expr->value->accept(this);
-  std::string name = expr->name.getLexeme();
-  environment->declareVar(name, value);
+Value Interpreter::visitVarDeclExpr(VarDeclExpr *expr) {
+  Value value = expr->value->accept(this);
+  if (expr->slot < 0) {
+    globals->declareVar(expr->name.getLexeme(), value);
+  } else {
+    Environment *frame = environment->ancestor(expr->depth);
+    if (expr->boxed) {
+      frame->declareBoxed(expr->slot, expr->name.getLexeme(), value);
+    } else {
+      frame->declareSlot(expr->slot, expr->name.getLexeme(), value);
+    }
+  }
+  if (expr->invalidatesMemos) {
+    memoEpoch++;
+  }
 
   // assignment expressions evaluate to the value assigned
   return value;
 }
 
-NObject *Interpreter::visitAssignExpr(AssignExpr *expr) {
-  NObject *value = expr->value->accept(this);
-  std::string name = expr->name.getLexeme();
-  environment->bind(name, value);
+Value Interpreter::visitAssignExpr(AssignExpr *expr) {
+  Value value = expr->value->accept(this);
+  if (expr->slot < 0) {
+    Value *binding = globals->find(&expr->cache);
+    if (binding != nullptr) {
+      *binding = value;
+    } else {
+      globals->bind(expr->name.getLexeme(), value);
+    }
+  } else if (expr->boxed) {
+    environment->ancestor(expr->depth)->setBoxed(expr->slot, value);
+  } else {
+    environment->ancestor(expr->depth)->setSlot(expr->slot, value);
+  }
+  if (expr->invalidatesMemos) {
+    memoEpoch++;
+  }
 
   // assignment expressions evaluate to the value assigned
   return value;
 }
 
-NObject *Interpreter::visitBinaryExpr(BinaryExpr* expr) {
+Value Interpreter::visitBinaryExpr(BinaryExpr* expr) {
+  LoopInvariant *invariant = expr->invariant;
+  if (invariant == nullptr) {
+    return evaluateBinaryExpr(expr);
+  }
+  if (invariant->run != invariant->loop->run) {
+    invariant->value = evaluateBinaryExpr(expr);
+    invariant->run = invariant->loop->run;
+  }
+  return invariant->value;
+}
+
+Value Interpreter::evaluateBinaryExpr(BinaryExpr *expr) {
   TokenType _operator = expr->_operator.getTokenType();
-  NObject *left = expr->left->accept(this);
-  NObject  *right = expr->right->accept(this);
+  TempRootScope scope(tempRoots);
+  Value left = expr->left->accept(this);
+  // Evaluating the right operand may call a function and trigger a collection
+  tempRoots.push_back(left);
+  Value right = expr->right->accept(this);
+
+  // Specialized on the operand types seen so far
+  TypeFeedback &feedback = expr->feedback;
+  if (feedback.specialization == SPECIALIZATION_REAL) {
+    if (areRealNumbers(left, right)) {
+      return operateReal(_operator, left.asNumber(), right.asNumber());
+    }
+    feedback.deoptimize();
+  } else if (feedback.specialization == SPECIALIZATION_NONE) {
+    feedback.observe(operandTypes(_operator, left, right));
+  }
 
+  // Results that can't escape the current call go into its region
+  RegionAllocation allocation(!expr->escapes);
+  AllocationSite site(expr->_operator);
+  if (feedback.specialization == SPECIALIZATION_COMPLEX) {
+    if (areComplexNumbers(left, right)) {
+      return operateComplex(_operator, (NComplexNumber *)left.asObject(),
+                            (NComplexNumber *)right.asObject());
+    }
+    feedback.deoptimize();
+  }
   switch (_operator) {
   case TOKEN_PLUS:
     // TODO: catch RuntimeException
@@ -231,23 +361,65 @@ NObject *Interpreter::visitBinaryExpr(BinaryExpr* expr) {
   default:
     // should be unreachable if parser is set up correctly
     throw ImplementationException("binary operator not handled in switch.");
-    return nullptr;
+    return Value();
     break;
   }
 
   // Unreachable
   throw ImplementationException("End of switch reached.");
-  return nullptr;
+  return Value();
 }
 
-NObject *Interpreter::visitGrouping(Grouping *expr) {
+Value Interpreter::visitGrouping(Grouping *expr) {
   return expr->contents->accept(this);
 }
 
-NObject *Interpreter::visitUnaryExpr(UnaryExpr *expr) {
+/**
+ * Same as visitBinaryExpr.
+ */
+Value Interpreter::visitUnaryExpr(UnaryExpr *expr) {
+  LoopInvariant *invariant = expr->invariant;
+  if (invariant == nullptr) {
+    return evaluateUnaryExpr(expr);
+  }
+  if (invariant->run != invariant->loop->run) {
+    invariant->value = evaluateUnaryExpr(expr);
+    invariant->run = invariant->loop->run;
+  }
+  return invariant->value;
+}
+
+Value Interpreter::evaluateUnaryExpr(UnaryExpr *expr) {
   TokenType _operator = expr->_operator.getTokenType();
-  NObject  *right = expr->right->accept(this);
+  Value right = expr->right->accept(this);
 
+  // Only negation is specialized
+  TypeFeedback &feedback = expr->feedback;
+  if (feedback.specialization == SPECIALIZATION_REAL) {
+    if (right.isNumber()) {
+      return Value(-right.asNumber());
+    }
+    feedback.deoptimize();
+  } else if (feedback.specialization == SPECIALIZATION_NONE &&
+             _operator == TOKEN_MINUS) {
+    if (right.isNumber()) {
+      feedback.observe(SPECIALIZATION_REAL);
+    } else if (isComplexNumber(right)) {
+      feedback.observe(SPECIALIZATION_COMPLEX);
+    } else {
+      feedback.observe(SPECIALIZATION_GENERIC);
+    }
+  }
+
+  RegionAllocation allocation(!expr->escapes);
+  AllocationSite site(expr->_operator);
+  if (feedback.specialization == SPECIALIZATION_COMPLEX) {
+    if (isComplexNumber(right)) {
+      NComplexNumber *number = (NComplexNumber *)right.asObject();
+      return Value(new NComplexNumber(-number->re, -number->im));
+    }
+    feedback.deoptimize();
+  }
   // TODO: implement all unary operators
   switch (_operator) {
   case TOKEN_MINUS:
@@ -264,42 +436,72 @@ NObject *Interpreter::visitUnaryExpr(UnaryExpr *expr) {
   default:
     // should be unreachable if parser is set up correctly
     throw ImplementationException("unary operator not handled.");
-    return nullptr;
+    return Value();
     break;
   }
 
   // Unreachable
   throw ImplementationException("End of switch reached.");
-  return nullptr;
+  return Value();
 }
 
-NObject *Interpreter::visitCallExpr(CallExpr *expr) {
+/**
+ * The callee and the arguments are evaluated into the argument stack, which
+ * the callee reads its arguments from.
+ */
+Value Interpreter::visitCallExpr(CallExpr *expr) {
+  ArgumentScope scope(argumentStack);
+  Value *values = argumentStack.push(expr->arguments.size() + 1);
+
   // Evaluate the callee
-  NObject *callee = expr->callee->accept(this);
+  Value callee = expr->callee->accept(this);
+  values[0] = callee;
 
   // Evaluate each argument in order
-  std::vector<NObject *> arguments;
   for (unsigned long i = 0; i < expr->arguments.size(); i++) {
-    arguments.push_back(expr->arguments[i]->accept(this));
+    values[i + 1] = expr->arguments[i]->accept(this);
   }
+  Arguments arguments(values + 1, expr->arguments.size());
 
-  if (!(callee->getType() == N_CALLABLE)) {
+  if (!(callee.getType() == N_CALLABLE)) {
     throw RuntimeException("object not callable.");
   }
-  NCallable *function = (NCallable *)callee;
+  NCallable *function = (NCallable *)callee.asObject();
   if (arguments.size() != (unsigned long)function->arity()) {
     throw RuntimeException("expected " + std::to_string(function->arity()) +
                            " arguments but got " +
                            std::to_string(arguments.size()) + ".");
   }
+  if (expr->tail) {
+    // Returns from the current function, whose callsite makes the call
+    requestTailCall(callee, arguments, &expr->paren);
+    return Value();
+  }
+  // Frames of the call (and anything a native function creates) are
+  // attributed to the call unless a site inside the callee takes over
+  AllocationSite site(expr->paren);
+  if (function->asClosure() == nullptr) {
+    noteSideEffect();
+  }
   // Function call may require interpreter
   return function->call(this, arguments);
 }
 
-NObject *Interpreter::visitIdentifier(Identifier *expr) {
-  NObject* value = environment->lookup(expr->token.getLexeme());
+Value Interpreter::visitIdentifier(Identifier *expr) {
+  Value value;
+  if (expr->slot < 0) {
+    Value *binding = globals->find(&expr->cache);
+    if (binding != nullptr) {
+      value = *binding;
+    }
+  } else if (expr->boxed) {
+    value = environment->ancestor(expr->depth)->getBoxed(expr->slot);
+  } else {
+    value = environment->ancestor(expr->depth)->getSlot(expr->slot);
+  }
 
-  if (value == nullptr) {
+  // Names bound to nil are treated as undefined
+  if (value.isUndefined() || value.isNull()) {
     throw RuntimeException("undefined variable '" + expr->token.getLexeme() +
                            "'.");
   }
@@ -307,43 +509,167 @@ NObject *Interpreter::visitIdentifier(Identifier *expr) {
   return value;
 }
 
-NObject *Interpreter::visitRealNumber(RealNumber *expr) {
-  return new NRealNumber(expr->value);
+/**
+ * Literals are turned into values once, when they are parsed.
+ */
+Value Interpreter::visitRealNumber(RealNumber *expr) {
+  return expr->constant;
 }
 
-NObject *Interpreter::visitImaginaryNumber(ImaginaryNumber *expr) {
-  return new NComplexNumber(0, expr->value);
+Value Interpreter::visitImaginaryNumber(ImaginaryNumber *expr) {
+  return expr->constant;
 }
 
-NObject *Interpreter::visitString(String *expr) {
-  return new NString(expr->token.getLexeme());
+Value Interpreter::visitString(String *expr) {
+  return expr->constant;
 }
 
-NObject *Interpreter::visitBoolean(Boolean *expr) {
-  if (expr->token.getTokenType() == TOKEN_TRUE) {
-    return new NBoolean(true);
+Value Interpreter::visitBoolean(Boolean *expr) {
+  return expr->constant;
+}
+
+Value Interpreter::visitKeywordConstant(KeywordConstant *expr) {
+  if (expr->constant.isUndefined()) {
+    throw ImplementationException("Keyword constant not handled in interpreter.");
   }
-  return new NBoolean(false);
+  return expr->constant;
 }
 
-NObject *Interpreter::visitKeywordConstant(KeywordConstant *expr) {
-  TokenType tokenType = expr->token.getTokenType();
+/**
+ * Marks every object the interpreter can still reach outside of the heap.
+ */
+void Interpreter::markRoots(Heap *heap) {
+  heap->mark(globals);
+  heap->mark(environment);
+  for (unsigned long i = 0; i < environmentStack.size(); i++) {
+    heap->mark(environmentStack[i]);
+  }
+  for (unsigned long i = 0; i < tempRoots.size(); i++) {
+    markValue(heap, tempRoots[i]);
+  }
+  markValue(heap, returnValue);
+  argumentStack.trace(heap);
+  markValue(heap, tailCallee);
+  for (unsigned long i = 0; i < tailCallArguments.size(); i++) {
+    markValue(heap, tailCallArguments[i]);
+  }
+  for (unsigned long i = 0; i < framePool.size(); i++) {
+    heap->mark(framePool[i]);
+  }
+  for (unsigned long i = 0; i < runningLoops.size(); i++) {
+    std::vector<LoopInvariant *> &invariants = runningLoops[i]->invariants;
+    for (unsigned long j = 0; j < invariants.size(); j++) {
+      if (invariants[j]->run != 0) {
+        markValue(heap, invariants[j]->value);
+      }
+    }
+  }
+}
 
-  switch (tokenType) {
-    case TOKEN_PI:
-      return new NRealNumber(pi);
-      break;
-    case TOKEN_EULER:
-      return new NRealNumber(euler);
-      break;
-    default:
-      throw ImplementationException("Keyword constant not handled in interpreter.");
-      break;
+/**
+ * Forgets the values the run computed, which may be in the region of the
+ * current call, and goes back to the run the loop is nested in.
+ * Values of enclosing runs stay valid.
+ */
+void Interpreter::endLoopRun(WhileStmt *stmt, unsigned long enclosingRun) {
+  for (unsigned long i = 0; i < stmt->invariants.size(); i++) {
+    if (stmt->invariants[i]->run == stmt->run) {
+      stmt->invariants[i]->run = 0;
+    }
   }
+  stmt->run = enclosingRun;
+  runningLoops.pop_back();
+}
 
-  // Unreachable
-  throw ImplementationException("End of switch reached.");
-  return nullptr;
+/**
+ * Returns an empty environment for a block or call, reusing a recycled one if
+ * possible.
+ */
+Environment *Interpreter::acquireFrame(Environment *enclosing,
+                                       unsigned long slotCount) {
+  if (framePool.empty()) {
+    return new Environment(enclosing, slotCount);
+  }
+  Environment *frame = framePool.back();
+  framePool.pop_back();
+  frame->reset(enclosing, slotCount);
+  return frame;
+}
+
+/**
+ * Called when the block or call that acquired a frame is done with it. Nothing
+ * refers to the frame anymore: closures only keep the cells of its captured
+ * variables.
+ */
+void Interpreter::releaseFrame(Environment *frame) {
+  if (framePool.size() >= MAX_POOLED_FRAMES) {
+    return;
+  }
+  // Drop the frame's references right away so they can be collected
+  frame->reset(nullptr, 0);
+  framePool.push_back(frame);
+}
+
+/**
+ * Returns the names bound in the global environment before any code runs.
+ */
+std::vector<std::string> Interpreter::getGlobalNames() {
+  return globals->getNames();
+}
+
+/**
+ * Forces a full garbage collection. Returns the number of objects freed.
+ */
+std::size_t Interpreter::collectGarbage() {
+  return heap()->collect();
+}
+
+/**
+ * Called by the callsite of a function that returned. Lowers the returning
+ * signal and stops keeping the value alive.
+ */
+Value Interpreter::takeReturnValue() {
+  Value value = returnValue;
+  returnValue = Value();
+  returning = false;
+  return value;
+}
+
+/**
+ * Returns from the current function, asking its callsite to call callee with
+ * the given arguments in its place.
+ */
+void Interpreter::requestTailCall(Value callee, Arguments arguments,
+                                  Token *site) {
+  tailCallee = callee;
+  tailCallArguments.assign(arguments.begin(), arguments.end());
+  tailCallSite = site;
+  tailCalling = true;
+  returnValue = Value();
+  returning = true;
+}
+
+/**
+ * Called by the callsite that makes a requested tail call, within an
+ * ArgumentScope. Lowers the returning signal and moves the callee and the
+ * arguments onto the argument stack, where they stay until the scope ends.
+ */
+TailCall Interpreter::takeTailCall() {
+  unsigned long count = tailCallArguments.size();
+  Value *values = argumentStack.push(count + 1);
+  values[0] = tailCallee;
+  for (unsigned long i = 0; i < count; i++) {
+    values[i + 1] = tailCallArguments[i];
+  }
+  TailCall call;
+  call.callee = tailCallee;
+  call.arguments = Arguments(values + 1, count);
+  call.site = tailCallSite;
+  tailCallee = Value();
+  tailCallArguments.clear();
+  tailCalling = false;
+  returning = false;
+  return call;
 }
 
 } // namespace napkin
@@ -1,63 +1,207 @@
 #ifndef NAPKIN_INTERPRETER_H_
 #define NAPKIN_INTERPRETER_H_
 
+#include <cstddef>
 #include <iostream>
 #include <vector>
 
 #include "AST.h"
 #include "ASTVisitor.h"
+#include "arguments.h"
+#include "budget.h"
 #include "constants.h"
 #include "environment.h"
+#include "heap.h"
 #include "nativefunction.h"
 #include "nclosure.h"
 #include "nexception.h"
 #include "nobject.h"
+#include "value.h"
 #include "noperator.h"
+#include "profiler.h"
+#include "value.h"
 
 namespace napkin {
 
+class ClosureCompiler;
+
+/**
+ * A call in tail position, made by the callsite of the function it ends
+ * rather than by the function itself (see NClosure::call).
+ */
+struct TailCall {
+  Value callee;
+  Arguments arguments;
+  // Token the call's allocations are attributed to
+  Token *site;
+};
+
 /**
  * Tree-walk interpreter.
+ * Also provides the garbage collector with its roots: the environments in use,
+ * temporaries held during evaluation, the arguments of calls, values being
+ * returned and the values of loop invariant operators.
  */
-class Interpreter : public ASTVisitor<NObject *> {
+class Interpreter : public ASTVisitor<Value>, public RootSource {
 public:
   Interpreter(bool repl = false);
+  ~Interpreter();
 
   void interpret(std::vector<Stmt *> stmts);
 
-  virtual NObject *visitStmt(Stmt *stmt);
-  virtual NObject *visitExprStmt(ExprStmt *stmt);
-  virtual NObject *visitOutputStmt(OutputStmt *stmt);
-  virtual NObject *visitBlockStmt(BlockStmt *stmt);
-  virtual NObject *visitIfStmt(IfStmt *stmt);
-  virtual NObject *visitWhileStmt(WhileStmt *stmt);
-  virtual NObject *visitReturnStmt(ReturnStmt *stmt);
-  virtual NObject *visitExpr(Expr *expr);
-  virtual NObject *visitLambdaExpr(LambdaExpr *expr);
-  virtual NObject *visitVarDeclExpr(VarDeclExpr *expr);
-  virtual NObject *visitAssignExpr(AssignExpr *expr);
-  virtual NObject *visitBinaryExpr(BinaryExpr *expr);
-  virtual NObject *visitGrouping(Grouping *expr);
-  virtual NObject *visitUnaryExpr(UnaryExpr *expr);
-  virtual NObject *visitCallExpr(CallExpr *expr);
-  virtual NObject *visitIdentifier(Identifier *expr);
-  virtual NObject *visitRealNumber(RealNumber *expr);
-  virtual NObject *visitImaginaryNumber(ImaginaryNumber *expr);
-  virtual NObject *visitString(String *expr);
-  virtual NObject *visitBoolean(Boolean *expr);
-  virtual NObject *visitKeywordConstant(KeywordConstant *expr);
-
-  NObject *executeBlockStmt(BlockStmt *stmt, Environment *environment);
+  virtual Value visitStmt(Stmt *stmt);
+  virtual Value visitExprStmt(ExprStmt *stmt);
+  virtual Value visitOutputStmt(OutputStmt *stmt);
+  virtual Value visitBlockStmt(BlockStmt *stmt);
+  virtual Value visitIfStmt(IfStmt *stmt);
+  virtual Value visitWhileStmt(WhileStmt *stmt);
+  virtual Value visitReturnStmt(ReturnStmt *stmt);
+  virtual Value visitExpr(Expr *expr);
+  virtual Value visitLambdaExpr(LambdaExpr *expr);
+  virtual Value visitVarDeclExpr(VarDeclExpr *expr);
+  virtual Value visitAssignExpr(AssignExpr *expr);
+  virtual Value visitBinaryExpr(BinaryExpr *expr);
+  virtual Value visitGrouping(Grouping *expr);
+  virtual Value visitUnaryExpr(UnaryExpr *expr);
+  virtual Value visitCallExpr(CallExpr *expr);
+  virtual Value visitIdentifier(Identifier *expr);
+  virtual Value visitRealNumber(RealNumber *expr);
+  virtual Value visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual Value visitString(String *expr);
+  virtual Value visitBoolean(Boolean *expr);
+  virtual Value visitKeywordConstant(KeywordConstant *expr);
+
+  Value executeBlockStmt(BlockStmt *stmt, Environment *environment);
+
+  // Frame recycling
+  Environment *acquireFrame(Environment *enclosing, unsigned long slotCount);
+  void releaseFrame(Environment *frame);
+
+  // Names the Resolver must treat as globals
+  std::vector<std::string> getGlobalNames();
+
+  // Garbage collection
+  virtual void markRoots(Heap *heap);
+  std::size_t collectGarbage();
+
+  // Return signal
+  bool isReturning() { return returning; }
+  Value takeReturnValue();
+
+  // Runs closures the JitCompiler supports as native code. Native code doesn't
+  // count steps, so it doesn't run under a limited budget.
+  void enableJit() { jit = true; }
+  bool isJitEnabled() { return jit && !budget.isLimited(); }
+
+  // Steps executed so far, and the limits on them
+  ExecutionBudget &getBudget() { return budget; }
+
+  // Memoization of pure closures (see MemoCache)
+  void disableMemoization() { memoize = false; }
+  bool isMemoizing() { return memoize; }
+  // Moves on when a variable pure closures may read is assigned
+  unsigned long getMemoEpoch() { return memoEpoch; }
+  void invalidateMemos() { memoEpoch++; }
+  // Counts the calls to native functions and impure closures
+  void noteSideEffect() { sideEffects++; }
+  unsigned long getSideEffects() { return sideEffects; }
+
+  // Throws a RuntimeException before a deep recursion overflows the C++ stack
+  void checkStack() {
+    char here;
+    if ((std::size_t)(stackBase - &here) > stackLimit) {
+      throw RuntimeException("stack overflow: recursion too deep.");
+    }
+  }
+
+  // Tail calls
+  void requestTailCall(Value callee, Arguments arguments, Token *site);
+  bool isTailCalling() { return tailCalling; }
+  TailCall takeTailCall();
 
 private:
+  // Runs compiled code on the interpreter's state
+  friend class ClosureCompiler;
+  // Roots the closures it jumps to in tail calls
+  friend class NClosure;
+
   // Current scope
   Environment *environment;
+  // Root of every environment (see Environment::root), kept so globals are
+  // found without walking up to it
   Environment *globals;
 
+  // Environments that are suspended while an inner block or call executes
+  std::vector<Environment *> environmentStack;
+
+  // Released frames that are ready to be reused
+  std::vector<Environment *> framePool;
+  static const unsigned long MAX_POOLED_FRAMES = 64;
+
+  // Intermediate values that must survive the evaluation of other
+  // subexpressions (e.g. the left operand while the right one is evaluated)
+  std::vector<Value> tempRoots;
+  // Callees and arguments of the calls being evaluated or running
+  ArgumentStack argumentStack;
+
+  // Value of the return statement that is completing
+  Value returnValue;
+  // True from a return statement until its call picks up the value. Blocks
+  // and loops check it after each statement instead of unwinding with an
+  // exception.
+  bool returning;
+  // Call to make once the returning signal reaches the callsite, if
+  // tailCalling is true. The arguments keep their capacity from one tail call
+  // to the next.
+  Value tailCallee;
+  std::vector<Value> tailCallArguments;
+  Token *tailCallSite;
+  bool tailCalling;
+
+  // Operators without their loop invariant cache
+  Value evaluateBinaryExpr(BinaryExpr *expr);
+  Value evaluateUnaryExpr(UnaryExpr *expr);
+
+  // Loops that are running, whose invariant operators may hold values
+  std::vector<WhileStmt *> runningLoops;
+  // Number of loop runs started so far
+  unsigned long loopRuns;
+  void endLoopRun(WhileStmt *stmt, unsigned long enclosingRun);
+
+  bool jit;
+
+  ExecutionBudget budget;
+
+  // Stack usage past which checkStack throws: the stack size limit, up to
+  // DEFAULT_STACK_LIMIT, less a margin for the frames of the call itself
+  char *stackBase;
+  std::size_t stackLimit;
+  static const std::size_t DEFAULT_STACK_LIMIT = 64 << 20;
+  static const std::size_t STACK_MARGIN = 256 << 10;
+
+  bool memoize;
+  unsigned long memoEpoch;
+  unsigned long sideEffects;
+
   // Whether or not we are running in a repl
   bool repl;
 };
 
+/**
+ * Pops every temporary root pushed during its lifetime, even when an exception
+ * is thrown.
+ */
+class TempRootScope {
+public:
+  TempRootScope(std::vector<Value> &t_roots)
+      : roots(t_roots), height(t_roots.size()){};
+  ~TempRootScope() { roots.resize(height); }
+
+private:
+  std::vector<Value> &roots;
+  unsigned long height;
+};
+
 } // namespace napkin
 
 #endif
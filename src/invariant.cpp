@@ -0,0 +1,261 @@
+#include "invariant.h"
+
+namespace napkin {
+
+InvariantAnalyzer::InvariantAnalyzer(Arena *t_arena) : arena(t_arena) {
+  mode = MODE_SEARCH;
+  loop = nullptr;
+  loopFrames = 0;
+  calls = false;
+  invariant = false;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::analyze(std::vector<Stmt *> &stmts) {
+  walk(MODE_SEARCH, stmts);
+}
+
+void InvariantAnalyzer::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void InvariantAnalyzer::visitExprStmt(ExprStmt *stmt) {
+  visitOutermost(stmt->expr);
+}
+
+void InvariantAnalyzer::visitOutputStmt(OutputStmt *stmt) {
+  visitOutermost(stmt->expr);
+}
+
+void InvariantAnalyzer::visitBlockStmt(BlockStmt *stmt) {
+  if (stmt->needsFrame) {
+    frames.push_back(stmt);
+  }
+  for (unsigned long i = 0; i < stmt->stmts.size(); i++) {
+    stmt->stmts[i]->accept(this);
+  }
+  if (stmt->needsFrame) {
+    frames.pop_back();
+  }
+}
+
+void InvariantAnalyzer::visitIfStmt(IfStmt *stmt) {
+  visitOutermost(stmt->condition);
+  stmt->thenBranch->accept(this);
+  if (stmt->elseBranch != nullptr) {
+    stmt->elseBranch->accept(this);
+  }
+}
+
+/**
+ * Each loop is analyzed on its own, inner loops included: the operators of an
+ * inner loop are invariant in the outer one only if they are in the inner one
+ * too.
+ */
+void InvariantAnalyzer::visitWhileStmt(WhileStmt *stmt) {
+  if (mode == MODE_MARKING) {
+    return;
+  }
+  if (mode == MODE_SEARCH) {
+    loop = stmt;
+    loopFrames = frames.size();
+    assigned.clear();
+    assignedGlobals.clear();
+    calls = false;
+
+    mode = MODE_EFFECTS;
+    stmt->condition->accept(this);
+    stmt->body->accept(this);
+    mode = MODE_MARKING;
+    visitOutermost(stmt->condition);
+    stmt->body->accept(this);
+    mode = MODE_SEARCH;
+  }
+  stmt->condition->accept(this);
+  stmt->body->accept(this);
+}
+
+void InvariantAnalyzer::visitReturnStmt(ReturnStmt *stmt) {
+  if (stmt->value != nullptr) {
+    visitOutermost(stmt->value);
+  }
+}
+
+void InvariantAnalyzer::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+/**
+ * The body only runs when the closure is called, so a loop's analysis skips
+ * it.
+ */
+void InvariantAnalyzer::visitLambdaExpr(LambdaExpr *expr) {
+  invariant = false;
+  cache = nullptr;
+  if (mode == MODE_EFFECTS || mode == MODE_MARKING) {
+    return;
+  }
+  expr->body->accept(this);
+}
+
+void InvariantAnalyzer::visitVarDeclExpr(VarDeclExpr *expr) {
+  visitOutermost(expr->value);
+  if (mode == MODE_EFFECTS) {
+    assign(expr->depth, expr->slot, expr->name.getLexeme());
+  }
+  invariant = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitAssignExpr(AssignExpr *expr) {
+  visitOutermost(expr->value);
+  if (mode == MODE_EFFECTS) {
+    assign(expr->depth, expr->slot, expr->name.getLexeme());
+  }
+  invariant = false;
+  cache = nullptr;
+}
+
+/**
+ * Only the outermost invariant operator of an expression is cached, by
+ * whichever node uses its value.
+ */
+void InvariantAnalyzer::visitBinaryExpr(BinaryExpr *expr) {
+  expr->left->accept(this);
+  bool leftInvariant = invariant;
+  bool leftReadsVariable = readsVariable;
+  LoopInvariant **leftCache = cache;
+  expr->right->accept(this);
+
+  if (leftInvariant && invariant) {
+    readsVariable = leftReadsVariable || readsVariable;
+    cache = &expr->invariant;
+    return;
+  }
+  hoist(leftCache, leftInvariant, leftReadsVariable);
+  hoist(cache, invariant, readsVariable);
+  invariant = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitGrouping(Grouping *expr) {
+  // Leaves the contents' results in place
+  expr->contents->accept(this);
+}
+
+void InvariantAnalyzer::visitUnaryExpr(UnaryExpr *expr) {
+  expr->right->accept(this);
+  if (invariant) {
+    cache = &expr->invariant;
+  }
+}
+
+void InvariantAnalyzer::visitCallExpr(CallExpr *expr) {
+  if (mode == MODE_EFFECTS) {
+    calls = true;
+  }
+  visitOutermost(expr->callee);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    visitOutermost(expr->arguments[i]);
+  }
+  invariant = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitIdentifier(Identifier *expr) {
+  invariant = mode == MODE_MARKING &&
+              isInvariant(expr->depth, expr->slot, expr->boxed,
+                          expr->token.getLexeme());
+  readsVariable = true;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitRealNumber(RealNumber *expr) {
+  invariant = true;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitImaginaryNumber(ImaginaryNumber *expr) {
+  invariant = true;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitString(String *expr) {
+  invariant = true;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitBoolean(Boolean *expr) {
+  invariant = true;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::visitKeywordConstant(KeywordConstant *expr) {
+  invariant = true;
+  readsVariable = false;
+  cache = nullptr;
+}
+
+void InvariantAnalyzer::walk(Mode t_mode, std::vector<Stmt *> &stmts) {
+  mode = t_mode;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    stmts[i]->accept(this);
+  }
+}
+
+void InvariantAnalyzer::visitOutermost(Expr *expr) {
+  expr->accept(this);
+  hoist(cache, invariant, readsVariable);
+}
+
+/**
+ * Operators that only read constants were folded already, or fail.
+ */
+void InvariantAnalyzer::hoist(LoopInvariant **t_cache, bool t_invariant,
+                              bool t_readsVariable) {
+  if (mode != MODE_MARKING || !t_invariant || !t_readsVariable ||
+      t_cache == nullptr || *t_cache != nullptr) {
+    return;
+  }
+  *t_cache = arena->make<LoopInvariant>(loop);
+  loop->invariants.push_back(*t_cache);
+}
+
+long InvariantAnalyzer::frameOf(unsigned long depth) {
+  return (long)frames.size() - 1 - (long)depth;
+}
+
+void InvariantAnalyzer::assign(unsigned long depth, long slot,
+                               const std::string &name) {
+  if (slot < 0) {
+    assignedGlobals.insert(name);
+    return;
+  }
+  long frame = frameOf(depth);
+  if (frame >= 0) {
+    assigned.insert(Variable(frames[frame], slot));
+  }
+}
+
+bool InvariantAnalyzer::isInvariant(unsigned long depth, long slot,
+                                    bool boxed, const std::string &name) {
+  if (slot < 0) {
+    return !calls && assignedGlobals.count(name) == 0;
+  }
+  long frame = frameOf(depth);
+  if (frame < 0 || (unsigned long)frame >= loopFrames) {
+    // Declared anew in each iteration
+    return false;
+  }
+  if (assigned.count(Variable(frames[frame], slot)) != 0) {
+    return false;
+  }
+  return !calls || !boxed;
+}
+
+} // namespace napkin
@@ -0,0 +1,108 @@
+#ifndef NAPKIN_INVARIANT_H_
+#define NAPKIN_INVARIANT_H_
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+#include "arena.h"
+
+namespace napkin {
+
+/**
+ * Finds the operators in while loops whose value can't change while the loop
+ * runs, so the interpreter only evaluates them once per run of the loop (see
+ * LoopInvariant). Runs after the Resolver.
+ *
+ * An operator is loop invariant if it only reads literals and variables the
+ * loop can't change:
+ * - variables declared outside of the loop and not assigned or declared in
+ *   it (variables are told apart by frame and slot, so an inner "x := ..."
+ *   doesn't hide an outer x, and "x = ..." is the variable it resolved to)
+ * - if the loop calls anything, neither globals nor variables closures
+ *   capture (see Identifier::boxed), since the callee may assign them
+ *
+ * Only the largest invariant operators are cached. Calls, assignments and
+ * lambdas are never invariant.
+ */
+class InvariantAnalyzer : public ASTVisitor<void> {
+public:
+  // LoopInvariants are created in the arena that owns the AST
+  InvariantAnalyzer(Arena *t_arena);
+
+  void analyze(std::vector<Stmt *> &stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  /**
+   * What a walk over the AST is for.
+   */
+  enum Mode {
+    MODE_SEARCH,  // find the loops
+    MODE_EFFECTS, // find what a loop assigns and whether it calls
+    MODE_MARKING  // mark the invariant operators of a loop
+  };
+
+  // A local variable: the block owning its frame and its slot
+  typedef std::pair<BlockStmt *, long> Variable;
+
+  void walk(Mode t_mode, std::vector<Stmt *> &stmts);
+  // Visits an expression that isn't the operand of an operator
+  void visitOutermost(Expr *expr);
+  // Caches the expression just visited if it is invariant, when marking
+  void hoist(LoopInvariant **t_cache, bool t_invariant, bool t_readsVariable);
+
+  // Returns the frame a variable addressed from the current frame is in
+  long frameOf(unsigned long depth);
+  void assign(unsigned long depth, long slot, const std::string &name);
+  bool isInvariant(unsigned long depth, long slot, bool boxed,
+                   const std::string &name);
+
+  Arena *arena;
+  Mode mode;
+
+  // Frames enclosing the node being visited (the innermost one is last)
+  std::vector<BlockStmt *> frames;
+
+  // The loop being analyzed and the index of the first frame inside of it
+  WhileStmt *loop;
+  unsigned long loopFrames;
+  // What the loop assigns
+  std::set<Variable> assigned;
+  std::set<std::string> assignedGlobals;
+  bool calls;
+
+  // Results of visiting an expression while marking
+  bool invariant;
+  bool readsVariable;
+  // Cache of the operator just visited, nullptr for other expressions
+  LoopInvariant **cache;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,833 @@
+#include "jit.h"
+
+#if defined(__x86_64__)
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "nclosure.h"
+#include "noperator.h"
+
+namespace napkin {
+
+#if defined(__x86_64__)
+
+// Bits of the values the generated code works with
+static uint64_t bitsOf(Value value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static Value valueOf(uint64_t bits) {
+  Value value;
+  std::memcpy((void *)&value, &bits, sizeof(bits));
+  return value;
+}
+
+static const uint64_t SIGN_BIT = 0x8000000000000000;
+
+/**
+ * Helpers called by the generated code.
+ * Guards that fail here count against the code of the frame they fail in.
+ */
+
+static void bailOut(JitFrame *frame) {
+  frame->bailed = true;
+  frame->code->bail();
+}
+
+// Reads a global variable
+static uint64_t jitLoad(JitFrame *frame, Identifier *identifier) {
+  Value *binding = frame->closure->getGlobals()->find(&identifier->cache);
+  Value value;
+  if (binding != nullptr) {
+    value = *binding;
+  }
+  // The interpreter reports undefined variables
+  if (value.isUndefined() || value.isNull()) {
+    bailOut(frame);
+  }
+  return bitsOf(value);
+}
+
+// Reads a variable the closure captured
+static uint64_t jitLoadCapture(JitFrame *frame, unsigned long index) {
+  Value value = frame->closure->getCapture(index);
+  if (value.isUndefined() || value.isNull()) {
+    bailOut(frame);
+  }
+  return bitsOf(value);
+}
+
+// Calls the closure in area[0] with the arguments that follow it
+static uint64_t jitCall(JitFrame *frame, Value *area, unsigned long arity) {
+  Value callee = area[0];
+  NClosure *closure = nullptr;
+  if (callee.getType() == N_CALLABLE) {
+    closure = ((NCallable *)callee.asObject())->asClosure();
+  }
+  if (closure == nullptr || (unsigned long)closure->arity() != arity ||
+      frame->depth + 1 >= JitCompiler::MAX_DEPTH) {
+    bailOut(frame);
+    return 0;
+  }
+  JitCode *code = JitCompiler::compile(closure->getExpr());
+  if (code->entry == nullptr) {
+    bailOut(frame);
+    return 0;
+  }
+  JitFrame calleeFrame(closure, code, frame->depth + 1);
+  uint64_t result = code->entry(area + 1, &calleeFrame);
+  frame->bailed = calleeFrame.bailed;
+  return result;
+}
+
+static bool jitIsSelf(JitFrame *frame, uint64_t callee) {
+  Value value = valueOf(callee);
+  return value.getType() == N_CALLABLE &&
+         ((NCallable *)value.asObject())->asClosure() == frame->closure;
+}
+
+static uint64_t jitPower(double left, double right) {
+  return bitsOf(nPower(Value(left), Value(right)));
+}
+
+static void jitBail(JitFrame *frame) {
+  bailOut(frame);
+}
+
+JitCode::~JitCode() {
+  if (memory != nullptr) {
+    munmap(memory, size);
+  }
+}
+
+/**
+ * The memory is only made executable once it is written.
+ */
+void JitCode::install(std::vector<uint8_t> &code) {
+  long page = sysconf(_SC_PAGESIZE);
+  size = (code.size() + page - 1) / page * page;
+  memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    memory = nullptr;
+    return;
+  }
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    return;
+  }
+  entry = (Entry)memory;
+}
+
+void JitCode::bail() {
+  bails++;
+  if (bails >= MAX_BAILS) {
+    entry = nullptr;
+  }
+}
+
+void X64Assembler::bytes(std::initializer_list<uint8_t> values) {
+  code.insert(code.end(), values);
+}
+
+void X64Assembler::imm32(uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    code.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+void X64Assembler::imm64(uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    code.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+unsigned long X64Assembler::newLabel() {
+  labels.push_back(-1);
+  return labels.size() - 1;
+}
+
+void X64Assembler::bind(unsigned long label) {
+  labels[label] = code.size();
+  for (unsigned long i = 0; i < fixups.size(); i++) {
+    if (fixups[i].second != label) {
+      continue;
+    }
+    unsigned long position = fixups[i].first;
+    uint32_t offset = (uint32_t)(labels[label] - (long)(position + 4));
+    std::memcpy(&code[position], &offset, sizeof(offset));
+  }
+}
+
+// jmp rel32
+void X64Assembler::jump(unsigned long label) {
+  bytes({0xe9});
+  reference(label);
+}
+
+// j<cc> rel32
+void X64Assembler::jump(Condition condition, unsigned long label) {
+  bytes({0x0f, (uint8_t)condition});
+  reference(label);
+}
+
+void X64Assembler::reference(unsigned long label) {
+  if (labels[label] >= 0) {
+    imm32((uint32_t)(labels[label] - (long)(code.size() + 4)));
+    return;
+  }
+  fixups.push_back(std::make_pair(code.size(), label));
+  imm32(0);
+}
+
+/**
+ * Lambdas that can't be compiled get code without an entry, so they are only
+ * looked at once.
+ */
+JitCode *JitCompiler::compile(LambdaExpr *expr) {
+  if (expr->jit != nullptr) {
+    return expr->jit;
+  }
+  expr->jit = expr->arena->make<JitCode>();
+  JitCompiler compiler(expr);
+  if (compiler.compileBody()) {
+    expr->jit->install(compiler.as.code);
+  }
+  return expr->jit;
+}
+
+JitCompiler::JitCompiler(LambdaExpr *t_lambda) : lambda(t_lambda) {
+  supported = true;
+  slotCount = 0;
+  pushed = 0;
+  valued = false;
+  numeric = false;
+  bodyLabel = as.newLabel();
+  returnLabel = as.newLabel();
+  bailLabel = as.newLabel();
+}
+
+/**
+ * Called with the arguments in rdi and the JitFrame in rsi.
+ */
+bool JitCompiler::compileBody() {
+  // push rbp; mov rbp, rsp; push rbx; push r12; push r13; push r14
+  as.bytes({0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56});
+  // sub rsp, <size of the slots, patched at the end>
+  as.bytes({0x48, 0x81, 0xec});
+  unsigned long frameSize = as.code.size();
+  as.imm32(0);
+  // mov rbx, rsp; mov r12, rsi
+  as.bytes({0x48, 0x89, 0xe3, 0x49, 0x89, 0xf4});
+  // mov r13, nil; mov r14, undefined
+  as.bytes({0x49, 0xbd});
+  as.imm64(bitsOf(Value()));
+  as.bytes({0x49, 0xbe});
+  as.imm64(bitsOf(Value::undefined()));
+
+  enterFrame(lambda->body, true);
+  frames.push_back(lambda->body);
+  as.bind(bodyLabel);
+  compileStmts(lambda->body->stmts, true);
+
+  as.bind(returnLabel);
+  // movq rax, xmm0; lea rsp, [rbp - 32]; pop r14; pop r13; pop r12; pop rbx;
+  // pop rbp; ret
+  as.bytes({0x66, 0x48, 0x0f, 0x7e, 0xc0, 0x48, 0x8d, 0x65, 0xe0, 0x41, 0x5e,
+            0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3});
+
+  as.bind(bailLabel);
+  // lea rsp, [rbp - 32] realigns the stack
+  as.bytes({0x48, 0x8d, 0x65, 0xe0});
+  // mov rdi, r12
+  as.bytes({0x4c, 0x89, 0xe7});
+  callHelper((void *)&jitBail);
+  as.jump(returnLabel);
+
+  // Keeps rsp 16 byte aligned below the 5 pushes
+  uint32_t size = (slotCount * 8 + 15) / 16 * 16;
+  std::memcpy(&as.code[frameSize], &size, sizeof(size));
+  return supported;
+}
+
+void JitCompiler::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void JitCompiler::visitExprStmt(ExprStmt *stmt) {
+  stmt->expr->accept(this);
+}
+
+// Output is a side effect, which couldn't be undone by bailing out
+void JitCompiler::visitOutputStmt(OutputStmt *stmt) {
+  supported = false;
+}
+
+void JitCompiler::visitBlockStmt(BlockStmt *stmt) {
+  if (stmt->needsFrame) {
+    enterFrame(stmt, false);
+    frames.push_back(stmt);
+  }
+  compileStmts(stmt->stmts, valued);
+  if (stmt->needsFrame) {
+    frames.pop_back();
+  }
+}
+
+void JitCompiler::visitIfStmt(IfStmt *stmt) {
+  bool ifValued = valued;
+  unsigned long elseLabel = as.newLabel();
+  unsigned long endLabel = as.newLabel();
+  branchIfFalse(stmt->condition, elseLabel);
+  compileStmt(stmt->thenBranch, ifValued);
+  as.jump(endLabel);
+  as.bind(elseLabel);
+  if (stmt->elseBranch != nullptr) {
+    compileStmt(stmt->elseBranch, ifValued);
+  } else if (ifValued) {
+    constant(Value());
+  }
+  as.bind(endLabel);
+}
+
+void JitCompiler::visitWhileStmt(WhileStmt *stmt) {
+  bool whileValued = valued;
+  unsigned long topLabel = as.newLabel();
+  unsigned long exitLabel = as.newLabel();
+  as.bind(topLabel);
+  branchIfFalse(stmt->condition, exitLabel);
+  compileStmt(stmt->body, false);
+  as.jump(topLabel);
+  as.bind(exitLabel);
+  if (whileValued) {
+    constant(Value());
+  }
+}
+
+void JitCompiler::visitReturnStmt(ReturnStmt *stmt) {
+  if (stmt->value != nullptr) {
+    stmt->value->accept(this);
+  } else {
+    constant(Value());
+  }
+  as.jump(returnLabel);
+}
+
+void JitCompiler::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+// Creating a closure allocates and captures cells, which don't exist here
+void JitCompiler::visitLambdaExpr(LambdaExpr *expr) {
+  supported = false;
+}
+
+void JitCompiler::visitVarDeclExpr(VarDeclExpr *expr) {
+  expr->value->accept(this);
+  long offset = localOffset(expr->depth, expr->slot);
+  // The interpreter moves the memo epoch on. Cells are only read.
+  if (offset < 0 || expr->boxed || expr->invalidatesMemos) {
+    supported = false;
+    return;
+  }
+  store(offset);
+}
+
+void JitCompiler::visitAssignExpr(AssignExpr *expr) {
+  expr->value->accept(this);
+  long offset = localOffset(expr->depth, expr->slot);
+  // The interpreter moves the memo epoch on. Cells are only read.
+  if (offset < 0 || expr->boxed || expr->invalidatesMemos) {
+    supported = false;
+    return;
+  }
+  store(offset);
+}
+
+/**
+ * Comparisons and logical operators are only compiled as conditions (see
+ * branchIfFalse), since their results are booleans.
+ */
+void JitCompiler::visitBinaryExpr(BinaryExpr *expr) {
+  TokenType type = expr->_operator.getTokenType();
+  if (type != TOKEN_PLUS && type != TOKEN_MINUS && type != TOKEN_STAR &&
+      type != TOKEN_SLASH && type != TOKEN_STAR_STAR) {
+    supported = false;
+    return;
+  }
+
+  expr->left->accept(this);
+  if (!numeric) {
+    guardNumber();
+  }
+  push();
+  expr->right->accept(this);
+  if (!numeric) {
+    guardNumber();
+  }
+  pop();
+
+  switch (type) {
+  case TOKEN_PLUS:
+    // addsd xmm0, xmm1
+    as.bytes({0xf2, 0x0f, 0x58, 0xc1});
+    break;
+  case TOKEN_MINUS:
+    // subsd xmm0, xmm1
+    as.bytes({0xf2, 0x0f, 0x5c, 0xc1});
+    break;
+  case TOKEN_STAR:
+    // mulsd xmm0, xmm1
+    as.bytes({0xf2, 0x0f, 0x59, 0xc1});
+    break;
+  case TOKEN_SLASH:
+    // divsd xmm0, xmm1
+    as.bytes({0xf2, 0x0f, 0x5e, 0xc1});
+    break;
+  default:
+    callHelper((void *)&jitPower);
+    // movq xmm0, rax
+    as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+    break;
+  }
+  numeric = true;
+}
+
+void JitCompiler::visitGrouping(Grouping *expr) {
+  expr->contents->accept(this);
+}
+
+void JitCompiler::visitUnaryExpr(UnaryExpr *expr) {
+  if (expr->_operator.getTokenType() != TOKEN_MINUS) {
+    supported = false;
+    return;
+  }
+  expr->right->accept(this);
+  if (!numeric) {
+    guardNumber();
+  }
+  // Flips the sign bit: mov rax, SIGN_BIT; movq xmm1, rax; xorpd xmm0, xmm1
+  as.bytes({0x48, 0xb8});
+  as.imm64(SIGN_BIT);
+  as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc8, 0x66, 0x0f, 0x57, 0xc1});
+  numeric = true;
+}
+
+/**
+ * The callee and the arguments are stored in slots of their own, which the
+ * callee reads its parameters from.
+ */
+void JitCompiler::visitCallExpr(CallExpr *expr) {
+  unsigned long arity = expr->arguments.size();
+  long area = allocateSlots(arity + 1) * 8;
+  expr->callee->accept(this);
+  store(area);
+  for (unsigned long i = 0; i < arity; i++) {
+    expr->arguments[i]->accept(this);
+    store(area + 8 * (i + 1));
+  }
+
+  unsigned long callLabel = as.newLabel();
+  if (expr->tail && pushed == 0 && arity == lambda->parameters.size()) {
+    // mov rdi, r12; mov rsi, [rbx + area]
+    as.bytes({0x4c, 0x89, 0xe7, 0x48, 0x8b, 0xb3});
+    as.imm32(area);
+    callHelper((void *)&jitIsSelf);
+    // test al, al
+    as.bytes({0x84, 0xc0});
+    as.jump(X64Assembler::CONDITION_EQUAL, callLabel);
+    // Calls itself: starts over with the new arguments
+    for (unsigned long i = 0; i < arity; i++) {
+      Identifier *parameter = lambda->parameters[i];
+      // mov rax, [rbx + argument]; mov [rbx + parameter], rax
+      as.bytes({0x48, 0x8b, 0x83});
+      as.imm32(area + 8 * (i + 1));
+      as.bytes({0x48, 0x89, 0x83});
+      as.imm32(8 * (frameSlots[lambda->body] + parameter->slot));
+    }
+    for (unsigned long i = 0; i < bodyLocals.size(); i++) {
+      // mov [rbx + local], r14
+      as.bytes({0x4c, 0x89, 0xb3});
+      as.imm32(bodyLocals[i]);
+    }
+    as.jump(bodyLabel);
+  }
+  as.bind(callLabel);
+
+  // mov rdi, r12; lea rsi, [rbx + area]; mov edx, arity
+  as.bytes({0x4c, 0x89, 0xe7, 0x48, 0x8d, 0xb3});
+  as.imm32(area);
+  as.bytes({0xba});
+  as.imm32(arity);
+  callHelper((void *)&jitCall);
+  checkBailed();
+  // movq xmm0, rax
+  as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+  numeric = false;
+}
+
+/**
+ * Cells are only found in the call frame, for the captured variables: a
+ * variable of the body is only boxed if a nested lambda captures it, and
+ * lambdas aren't compiled.
+ */
+void JitCompiler::visitIdentifier(Identifier *expr) {
+  if (expr->boxed) {
+    long capture = captureIndex(expr);
+    if (capture < 0) {
+      supported = false;
+      return;
+    }
+    // mov rdi, r12; mov esi, capture
+    as.bytes({0x4c, 0x89, 0xe7, 0xbe});
+    as.imm32(capture);
+    callHelper((void *)&jitLoadCapture);
+    checkBailed();
+    // movq xmm0, rax
+    as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+    numeric = false;
+    return;
+  }
+  long offset = localOffset(expr->depth, expr->slot);
+  if (offset >= 0) {
+    load(offset);
+    numeric = false;
+    return;
+  }
+  if (expr->slot >= 0) {
+    supported = false;
+    return;
+  }
+
+  // mov rdi, r12; mov rsi, identifier
+  as.bytes({0x4c, 0x89, 0xe7, 0x48, 0xbe});
+  as.imm64((uint64_t)expr);
+  callHelper((void *)&jitLoad);
+  checkBailed();
+  // movq xmm0, rax
+  as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+  numeric = false;
+}
+
+void JitCompiler::visitRealNumber(RealNumber *expr) {
+  constant(expr->constant);
+}
+
+void JitCompiler::visitImaginaryNumber(ImaginaryNumber *expr) {
+  constant(expr->constant);
+}
+
+void JitCompiler::visitString(String *expr) {
+  constant(expr->constant);
+}
+
+void JitCompiler::visitBoolean(Boolean *expr) {
+  constant(expr->constant);
+}
+
+void JitCompiler::visitKeywordConstant(KeywordConstant *expr) {
+  constant(expr->constant);
+}
+
+void JitCompiler::compileStmt(Stmt *stmt, bool t_valued) {
+  valued = t_valued;
+  stmt->accept(this);
+}
+
+/**
+ * The value of an empty block is nil.
+ */
+void JitCompiler::compileStmts(std::vector<Stmt *> &stmts, bool t_valued) {
+  if (stmts.empty() && t_valued) {
+    constant(Value());
+  }
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    compileStmt(stmts[i], t_valued && i + 1 == stmts.size());
+  }
+}
+
+/**
+ * Both operands of "and" and "or" are evaluated, like in the interpreter, so
+ * a guard in the second one fails even if the first one decides.
+ * Comparisons are false if either operand is NaN, and truthy numbers are the
+ * ones that aren't 0 (including NaN).
+ */
+void JitCompiler::branchIfFalse(Expr *condition, unsigned long label) {
+  Grouping *grouping = dynamic_cast<Grouping *>(condition);
+  if (grouping != nullptr) {
+    branchIfFalse(grouping->contents, label);
+    return;
+  }
+
+  UnaryExpr *unary = dynamic_cast<UnaryExpr *>(condition);
+  if (unary != nullptr && (unary->_operator.getTokenType() == TOKEN_NOT ||
+                           unary->_operator.getTokenType() == TOKEN_BANG)) {
+    unsigned long falseLabel = as.newLabel();
+    branchIfFalse(unary->right, falseLabel);
+    as.jump(label);
+    as.bind(falseLabel);
+    return;
+  }
+
+  BinaryExpr *binary = dynamic_cast<BinaryExpr *>(condition);
+  TokenType type = binary != nullptr ? binary->_operator.getTokenType()
+                                     : TOKEN_EOF;
+  if (type == TOKEN_AND || type == TOKEN_OR) {
+    unsigned long leftFalse = as.newLabel();
+    unsigned long endLabel = as.newLabel();
+    branchIfFalse(binary->left, leftFalse);
+    // Left is true: "and" depends on right, "or" is true
+    branchIfFalse(binary->right, type == TOKEN_AND ? label : endLabel);
+    as.jump(endLabel);
+    as.bind(leftFalse);
+    // Left is false: "and" is false, "or" depends on right
+    branchIfFalse(binary->right, label);
+    if (type == TOKEN_AND) {
+      as.jump(label);
+    }
+    as.bind(endLabel);
+    return;
+  }
+
+  if (type == TOKEN_LESS || type == TOKEN_LESS_EQUAL || type == TOKEN_GREATER ||
+      type == TOKEN_GREATER_EQUAL || type == TOKEN_EQUAL_EQUAL ||
+      type == TOKEN_BANG_EQUAL) {
+    binary->left->accept(this);
+    if (!numeric) {
+      guardNumber();
+    }
+    push();
+    binary->right->accept(this);
+    if (!numeric) {
+      guardNumber();
+    }
+    pop();
+
+    // ucomisd sets CF for "below" and ZF for "equal", and all of ZF, PF and
+    // CF for unordered operands
+    unsigned long trueLabel = as.newLabel();
+    switch (type) {
+    case TOKEN_LESS:
+      // ucomisd xmm1, xmm0
+      as.bytes({0x66, 0x0f, 0x2e, 0xc8});
+      as.jump(X64Assembler::CONDITION_BELOW_EQUAL, label);
+      break;
+    case TOKEN_LESS_EQUAL:
+      as.bytes({0x66, 0x0f, 0x2e, 0xc8});
+      as.jump(X64Assembler::CONDITION_BELOW, label);
+      break;
+    case TOKEN_GREATER:
+      // ucomisd xmm0, xmm1
+      as.bytes({0x66, 0x0f, 0x2e, 0xc1});
+      as.jump(X64Assembler::CONDITION_BELOW_EQUAL, label);
+      break;
+    case TOKEN_GREATER_EQUAL:
+      as.bytes({0x66, 0x0f, 0x2e, 0xc1});
+      as.jump(X64Assembler::CONDITION_BELOW, label);
+      break;
+    case TOKEN_EQUAL_EQUAL:
+      as.bytes({0x66, 0x0f, 0x2e, 0xc1});
+      as.jump(X64Assembler::CONDITION_NOT_EQUAL, label);
+      as.jump(X64Assembler::CONDITION_PARITY, label);
+      break;
+    default:
+      as.bytes({0x66, 0x0f, 0x2e, 0xc1});
+      as.jump(X64Assembler::CONDITION_PARITY, trueLabel);
+      as.jump(X64Assembler::CONDITION_EQUAL, label);
+      break;
+    }
+    as.bind(trueLabel);
+    return;
+  }
+
+  Boolean *boolean = dynamic_cast<Boolean *>(condition);
+  if (boolean != nullptr) {
+    if (!boolean->constant.asBoolean()) {
+      as.jump(label);
+    }
+    return;
+  }
+
+  condition->accept(this);
+  if (!numeric) {
+    guardNumber();
+  }
+  // xorpd xmm1, xmm1; ucomisd xmm0, xmm1
+  as.bytes({0x66, 0x0f, 0x57, 0xc9, 0x66, 0x0f, 0x2e, 0xc1});
+  unsigned long trueLabel = as.newLabel();
+  as.jump(X64Assembler::CONDITION_PARITY, trueLabel);
+  as.jump(X64Assembler::CONDITION_EQUAL, label);
+  as.bind(trueLabel);
+}
+
+long JitCompiler::localOffset(unsigned long depth, long slot) {
+  if (slot < 0 || depth >= frames.size()) {
+    return -1;
+  }
+  BlockStmt *block = frames[frames.size() - 1 - depth];
+  return 8 * (frameSlots[block] + slot);
+}
+
+long JitCompiler::captureIndex(Identifier *expr) {
+  if (expr->depth + 1 != frames.size()) {
+    return -1;
+  }
+  for (unsigned long i = 0; i < lambda->captures.size(); i++) {
+    if (lambda->captures[i].frameSlot == (unsigned long)expr->slot) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+long JitCompiler::allocateSlots(unsigned long count) {
+  unsigned long first = slotCount;
+  slotCount += count;
+  return first;
+}
+
+/**
+ * Variables start out undefined in every frame. The call frame gets the
+ * arguments instead for its parameters.
+ */
+void JitCompiler::enterFrame(BlockStmt *block, bool isBody) {
+  unsigned long first = allocateSlots(block->slotCount);
+  frameSlots[block] = first;
+
+  std::vector<bool> isParameter(block->slotCount, false);
+  if (isBody) {
+    for (unsigned long i = 0; i < lambda->parameters.size(); i++) {
+      long slot = lambda->parameters[i]->slot;
+      isParameter[slot] = true;
+      // mov rax, [rdi + 8i]; mov [rbx + parameter], rax
+      as.bytes({0x48, 0x8b, 0x87});
+      as.imm32(8 * i);
+      as.bytes({0x48, 0x89, 0x83});
+      as.imm32(8 * (first + slot));
+    }
+  }
+  for (unsigned long slot = 0; slot < block->slotCount; slot++) {
+    if (isParameter[slot]) {
+      continue;
+    }
+    // mov [rbx + slot], r14
+    as.bytes({0x4c, 0x89, 0xb3});
+    as.imm32(8 * (first + slot));
+    if (isBody) {
+      bodyLocals.push_back(8 * (first + slot));
+    }
+  }
+}
+
+void JitCompiler::constant(Value value) {
+  // mov rax, bits; movq xmm0, rax
+  as.bytes({0x48, 0xb8});
+  as.imm64(bitsOf(value));
+  as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+  numeric = value.isNumber();
+}
+
+/**
+ * Bails out on undefined variables and nil, which the interpreter reports.
+ */
+void JitCompiler::load(long offset) {
+  // mov rax, [rbx + offset]
+  as.bytes({0x48, 0x8b, 0x83});
+  as.imm32(offset);
+  // mov rcx, rax; or rcx, 1; cmp rcx, r13; je bail
+  as.bytes({0x48, 0x89, 0xc1, 0x48, 0x83, 0xc9, 0x01, 0x4c, 0x39, 0xe9});
+  as.jump(X64Assembler::CONDITION_EQUAL, bailLabel);
+  // movq xmm0, rax
+  as.bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+}
+
+void JitCompiler::store(long offset) {
+  // movsd [rbx + offset], xmm0
+  as.bytes({0xf2, 0x0f, 0x11, 0x83});
+  as.imm32(offset);
+}
+
+void JitCompiler::push() {
+  // sub rsp, 8; movsd [rsp], xmm0
+  as.bytes({0x48, 0x83, 0xec, 0x08, 0xf2, 0x0f, 0x11, 0x04, 0x24});
+  pushed++;
+}
+
+/**
+ * Pops into xmm0 and moves the current value into xmm1.
+ */
+void JitCompiler::pop() {
+  // movapd xmm1, xmm0; movsd xmm0, [rsp]; add rsp, 8
+  as.bytes({0x66, 0x0f, 0x28, 0xc8, 0xf2, 0x0f, 0x10, 0x04, 0x24, 0x48, 0x83,
+            0xc4, 0x08});
+  pushed--;
+}
+
+/**
+ * Bails out unless xmm0 holds a real number: its bits, masked with the bits
+ * of undefined, must not be the mask itself.
+ */
+void JitCompiler::guardNumber() {
+  // movq rax, xmm0; mov rcx, rax; and rcx, r14; cmp rcx, r14; je bail
+  as.bytes({0x66, 0x48, 0x0f, 0x7e, 0xc0, 0x48, 0x89, 0xc1, 0x4c, 0x21, 0xf1,
+            0x4c, 0x39, 0xf1});
+  as.jump(X64Assembler::CONDITION_EQUAL, bailLabel);
+}
+
+/**
+ * Calls a C++ function with rsp 16 byte aligned.
+ */
+void JitCompiler::callHelper(void *function) {
+  bool pad = pushed % 2 == 1;
+  if (pad) {
+    // sub rsp, 8
+    as.bytes({0x48, 0x83, 0xec, 0x08});
+  }
+  // mov rax, function; call rax
+  as.bytes({0x48, 0xb8});
+  as.imm64((uint64_t)function);
+  as.bytes({0xff, 0xd0});
+  if (pad) {
+    // add rsp, 8
+    as.bytes({0x48, 0x83, 0xc4, 0x08});
+  }
+}
+
+/**
+ * Returns right away if a helper bailed out (it already counted it).
+ */
+void JitCompiler::checkBailed() {
+  // cmp byte [r12 + bailed], 0; jne return
+  as.bytes({0x41, 0x80, 0x7c, 0x24, (uint8_t)offsetof(JitFrame, bailed), 0x00});
+  as.jump(X64Assembler::CONDITION_NOT_EQUAL, returnLabel);
+}
+
+bool runNative(NClosure *closure, Arguments arguments, Value &result) {
+  JitCode *code = JitCompiler::compile(closure->getExpr());
+  if (code->entry == nullptr) {
+    return false;
+  }
+  JitFrame frame(closure, code, 0);
+  Value value = valueOf(code->entry(arguments.begin(), &frame));
+  if (frame.bailed) {
+    return false;
+  }
+  // Arithmetic doesn't produce the NaN the interpreter would
+  if (value.isNumber() && value.asNumber() != value.asNumber()) {
+    value = Value(value.asNumber());
+  }
+  result = value;
+  return true;
+}
+
+#else
+
+bool runNative(NClosure *, Arguments, Value &) { return false; }
+
+#endif
+
+} // namespace napkin
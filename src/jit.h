@@ -0,0 +1,223 @@
+#ifndef NAPKIN_JIT_H_
+#define NAPKIN_JIT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+#include "arguments.h"
+#include "value.h"
+
+namespace napkin {
+
+class JitCode;
+class NClosure;
+
+// The JitCompiler emits x86-64 code. Other targets have no JIT, and reject
+// --jit.
+#if defined(__x86_64__)
+
+/**
+ * State of a call running native code.
+ */
+struct JitFrame {
+  JitFrame(NClosure *t_closure, JitCode *t_code, unsigned long t_depth)
+      : closure(t_closure), code(t_code), depth(t_depth), bailed(false){};
+
+  NClosure *closure;
+  JitCode *code;
+  // Number of native calls below this one
+  unsigned long depth;
+  // Set when a guard fails. The native calls return right away and the
+  // outermost one is run again by the interpreter.
+  bool bailed;
+};
+
+/**
+ * Native code for the body of a lambda (see LambdaExpr::jit).
+ */
+class JitCode {
+public:
+  // Takes the arguments of the call, returns the bits of the resulting Value
+  typedef uint64_t (*Entry)(Value *arguments, JitFrame *frame);
+
+  JitCode() : entry(nullptr), bails(0), memory(nullptr), size(0){};
+  ~JitCode();
+
+  // Copies machine code into executable memory
+  void install(std::vector<uint8_t> &code);
+
+  // Counts a failed guard, and gives up on the code after MAX_BAILS
+  void bail();
+
+  // nullptr if the body can't be compiled, or bailed out too often
+  Entry entry;
+  unsigned long bails;
+
+  static const unsigned long MAX_BAILS = 8;
+
+private:
+  void *memory;
+  std::size_t size;
+};
+
+/**
+ * Small x86-64 assembler: only the instructions the JitCompiler needs, with
+ * rel32 jumps to labels that are patched when the label is bound.
+ */
+class X64Assembler {
+public:
+  // Second opcode byte of the "j<cc> rel32" instructions
+  enum Condition {
+    CONDITION_BELOW = 0x82,
+    CONDITION_EQUAL = 0x84,
+    CONDITION_NOT_EQUAL = 0x85,
+    CONDITION_BELOW_EQUAL = 0x86,
+    CONDITION_PARITY = 0x8a
+  };
+
+  void bytes(std::initializer_list<uint8_t> values);
+  void imm32(uint32_t value);
+  void imm64(uint64_t value);
+
+  unsigned long newLabel();
+  void bind(unsigned long label);
+  void jump(unsigned long label);
+  void jump(Condition condition, unsigned long label);
+
+  std::vector<uint8_t> code;
+
+private:
+  void reference(unsigned long label);
+
+  // Position of each label, -1 until bound
+  std::vector<long> labels;
+  // Positions of the rel32 operands to patch: (position, label)
+  std::vector<std::pair<unsigned long, unsigned long>> fixups;
+};
+
+/**
+ * Template JIT for numeric closures, enabled by --jit: each node of a lambda's
+ * body is translated into a fixed sequence of x86-64 instructions.
+ *
+ * Supported bodies only use literals, local variables and parameters, reads of
+ * captured variables and globals, the arithmetic operators, comparisons and
+ * "and", "or" and "not" in conditions, if, while, return, and calls to
+ * closures. Anything else (output, lambdas, assignments to globals or
+ * captured variables, ...) leaves the lambda to the interpreter.
+ *
+ * Values keep their NaN-boxed representation, so parameters may be closures.
+ * Operators check that their operands are real numbers. Such guards, reads of
+ * undefined variables, calls to closures that aren't compiled and deep
+ * recursion all bail out: since compiled code has no side effects, the
+ * outermost native call simply gives up and the interpreter runs it again.
+ * Calls in tail position to the running closure jump back to the start of
+ * the body.
+ *
+ * Registers: rbx points at the local slots, r12 at the JitFrame, r13 holds
+ * the bits of nil and r14 those of undefined (which are also the NaN-boxing
+ * mask). Expressions leave their value in xmm0, temporaries are pushed on
+ * the stack.
+ */
+class JitCompiler : public ASTVisitor<void> {
+public:
+  // Returns the lambda's code, compiling it the first time
+  static JitCode *compile(LambdaExpr *expr);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+  // Bails out of calls nested deeper than this
+  static const unsigned long MAX_DEPTH = 4096;
+
+private:
+  JitCompiler(LambdaExpr *t_lambda);
+
+  // Returns false if the body isn't supported
+  bool compileBody();
+
+  // Statements whose value is the value of the call leave it in xmm0
+  void compileStmt(Stmt *stmt, bool t_valued);
+  void compileStmts(std::vector<Stmt *> &stmts, bool t_valued);
+  // Jumps to a label if a condition is false
+  void branchIfFalse(Expr *condition, unsigned long label);
+
+  // Slot offsets from rbx, -1 for variables outside of the call frame
+  long localOffset(unsigned long depth, long slot);
+  // Index in LambdaExpr::captures of a captured variable, -1 for other cells
+  long captureIndex(Identifier *expr);
+  long allocateSlots(unsigned long count);
+  void enterFrame(BlockStmt *block, bool isBody);
+
+  void constant(Value value);
+  void load(long offset);
+  void store(long offset);
+  void push();
+  void pop();
+  void guardNumber();
+  void callHelper(void *function);
+  void checkBailed();
+
+  LambdaExpr *lambda;
+  X64Assembler as;
+  bool supported;
+
+  // Frames of the blocks being compiled (the call frame is first) and the
+  // first slot of each one
+  std::vector<BlockStmt *> frames;
+  std::unordered_map<BlockStmt *, unsigned long> frameSlots;
+  unsigned long slotCount;
+  // Offsets of the call frame's variables that aren't parameters
+  std::vector<long> bodyLocals;
+
+  // Temporaries currently pushed on the stack
+  unsigned long pushed;
+  // True if the statement being compiled must leave its value in xmm0
+  bool valued;
+  // True if the last expression compiled is always a real number
+  bool numeric;
+
+  // Start of the body, after the parameters are copied
+  unsigned long bodyLabel;
+  // Epilogue, returns the value in xmm0
+  unsigned long returnLabel;
+  // Counts a failed guard and returns
+  unsigned long bailLabel;
+};
+
+#endif
+
+/**
+ * Runs a closure's compiled code, compiling it first if needed. Returns false
+ * if it has to be run by the interpreter instead, which is always the case on
+ * targets without a JIT.
+ */
+bool runNative(NClosure *closure, Arguments arguments, Value &result);
+
+} // namespace napkin
+
+#endif
@@ -1,7 +1,9 @@
 #include <cerrno>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,8 +11,122 @@
 #include "lexer.h"
 #include "AST.h"
 #include "ASTPrinter.h"
+#include "arena.h"
+#include "closurecompiler.h"
+#include "compiler.h"
+#include "escape.h"
+#include "folder.h"
+#include "invariant.h"
 #include "parser.h"
+#include "profiler.h"
+#include "purity.h"
+#include "resolver.h"
+#include "heap.h"
 #include "interpreter.h"
+#include "vm.h"
+
+/**
+ * Command line options for running a file.
+ */
+struct Options {
+  // Print the tokens lexed
+  bool dumpTokens = false;
+  // Print a representation of the AST
+  bool dumpAST = false;
+  // Print how many allocations the heap's size class pools and the call
+  // regions absorbed
+  bool poolStats = false;
+  // Print how many operator sites the interpreter specialized on the types of
+  // their operands
+  bool quickenStats = false;
+  // Profile heap allocations by type and allocation site
+  bool heapStats = false;
+  // Milliseconds between heap profile dumps while running (0 for none)
+  unsigned long heapStatsInterval = 0;
+  // Compile to bytecode and run it on the VM instead of walking the AST. The
+  // VM doesn't memoize calls.
+  bool vm = false;
+  // Print the bytecode (implies vm)
+  bool dumpBytecode = false;
+  // Nested calls the VM allows (0 for its default)
+  unsigned long maxDepth = 0;
+  // Compile the AST into C++ closures run on the Interpreter's state
+  bool closures = false;
+  // Run numeric closures as native code
+  bool jit = false;
+  // Memoize calls to pure closures
+  bool memo = true;
+  // Print how many memoized calls were found in the cache
+  bool memoStats = false;
+  // Steps and milliseconds the run may take (0 for no limit)
+  unsigned long maxSteps = 0;
+  unsigned long timeout = 0;
+  // Print how many steps the run executed
+  bool stepCount = false;
+};
+
+/**
+ * Prints the command line flags.
+ */
+void printUsage() {
+  std::cout
+      << "Usage: napkin [filename [flags]]\n"
+      << "Without a filename, starts the REPL.\n"
+      << "\n"
+      << "Flags:\n"
+      << "  --dump-tokens            print the tokens lexed\n"
+      << "  --dump-ast               print the AST\n"
+      << "  --vm                     run on the bytecode VM (no memoization)\n"
+      << "  --dump-bytecode          print the bytecode (implies --vm)\n"
+      << "  --max-depth N            deepest VM recursion (implies --vm)\n"
+      << "  --closures               compile the AST into C++ closures\n"
+#if defined(__x86_64__)
+      << "  --jit                    run numeric closures as native code\n"
+#else
+      << "  --jit                    x86-64 only, rejected on this target\n"
+#endif
+      << "  --no-memo                don't memoize calls to pure closures\n"
+      << "  --memo-stats             print memoization cache hits and misses\n"
+      << "  --max-steps N            stop the run after N steps\n"
+      << "  --timeout-ms N           stop the run after N milliseconds\n"
+      << "  --step-count             print the steps the run took\n"
+      << "  --pool-stats             print allocations absorbed by the pools\n"
+      << "  --quicken-stats          print the specialized operator sites\n"
+      << "  --heap-stats             print a heap allocation profile\n"
+      << "  --heap-stats-interval N  also print it every N ms\n"
+      << "  --gc-threshold N         heap bytes before the collector runs\n"
+      << "\n"
+      << "A step is a statement or a loop iteration, or on the VM a loop\n"
+      << "iteration or a call. Native code doesn't count steps, so --jit is\n"
+      << "ignored when --max-steps or --timeout-ms is given.\n";
+}
+
+/**
+ * Prints a table of allocations per heap size class.
+ */
+void printPoolStats() {
+  napkin::Heap *heap = napkin::heap();
+  std::size_t allocations = 0;
+  std::size_t reuses = 0;
+  std::cerr << "size class  allocations      reused   slabs" << std::endl;
+  for (std::size_t i = 0; i < heap->getPoolCount(); i++) {
+    napkin::Pool *pool = heap->getPool(i);
+    if (pool->getAllocations() == 0) {
+      continue;
+    }
+    std::cerr << std::setw(10) << pool->getBlockSize() << std::setw(13)
+              << pool->getAllocations() << std::setw(12) << pool->getReuses()
+              << std::setw(8) << pool->getSlabCount() << std::endl;
+    allocations += pool->getAllocations();
+    reuses += pool->getReuses();
+  }
+  std::cerr << "pooled allocations: " << allocations << " (" << reuses
+            << " recycled), large allocations: "
+            << heap->getLargeAllocations() << std::endl;
+  std::cerr << "region allocations: " << heap->getRegion()->getAllocations()
+            << " (peak " << heap->getRegion()->getPeakBytes() << " bytes)"
+            << std::endl;
+}
 
 /**
  * Runs an interactive prompt
@@ -18,11 +134,21 @@
  */
 void runRepl() {
   napkin::Interpreter interpreter(true);
+  // Remembers the globals declared by earlier lines
+  napkin::Resolver resolver(interpreter.getGlobalNames());
+  // Later lines may add pure closures reading the globals of earlier ones
+  napkin::PurityAnalyzer purity(true);
   std::string source;
+  // Lines whose closures may still be called
+  std::vector<std::unique_ptr<napkin::Arena>> units;
   while (1) {
     // Display prompt
     std::cout << "> ";
-    std::getline(std::cin, source);
+    if (!std::getline(std::cin, source)) {
+      // End of input
+      std::cout << std::endl;
+      return;
+    }
 
     // Lex
     napkin::Lexer lexer(source);
@@ -32,7 +158,10 @@ void runRepl() {
     }
 
     // Parse
-    napkin::Parser parser(tokens);
+    // The line's AST is freed at the end of the iteration unless it created
+    // closures that are still alive
+    std::unique_ptr<napkin::Arena> arena(new napkin::Arena);
+    napkin::Parser parser(tokens, arena.get());
     std::vector<napkin::Stmt *> stmts;
     try {
       stmts = parser.parse();
@@ -44,6 +173,11 @@ void runRepl() {
     if (parser.hadError) {
       continue;
     }
+    napkin::ConstantFolder(arena.get()).fold(stmts);
+    resolver.resolve(stmts);
+    napkin::EscapeAnalyzer().analyze(stmts);
+    napkin::InvariantAnalyzer(arena.get()).analyze(stmts);
+    purity.analyze(stmts);
 
     // Interpret and print result
     try {
@@ -51,7 +185,18 @@ void runRepl() {
     }
     catch (napkin::RuntimeException &e) {
       std::cout << e.what() << std::endl;
-      continue;
+    }
+
+    if (arena->isRetained()) {
+      units.push_back(std::move(arena));
+    }
+    // Free earlier lines once the collector has freed all of their closures
+    for (unsigned long i = 0; i < units.size();) {
+      if (units[i]->isRetained()) {
+        i++;
+      } else {
+        units.erase(units.begin() + i);
+      }
     }
   }
 }
@@ -80,10 +225,9 @@ std::string readFile(std::string fileName) {
 
 /**
  * Execute napkin source code stored in a file.
- * @param dumpTokens If true, will print tokens lexed
- * @param dumpAST If true, will print a representation of the AST
+ * @param options Which debugging output to print
  */
-int runFile(std::string fileName, bool dumpTokens, bool dumpAST) {
+int runFile(std::string fileName, Options options) {
   std::string source;
   try {
     source = readFile(fileName);
@@ -95,7 +239,7 @@ int runFile(std::string fileName, bool dumpTokens, bool dumpAST) {
 
   napkin::Lexer lexer(source);
   std::vector<napkin::Token> tokens = lexer.getTokens();
-  if (dumpTokens) {
+  if (options.dumpTokens) {
     for (unsigned int i = 0; i < tokens.size(); i++) {
       std::cout << tokens[i].tokenTypeAsString() << " : "
                 << tokens[i].getLexeme() << " line: " << tokens[i].getLine()
@@ -103,25 +247,104 @@ int runFile(std::string fileName, bool dumpTokens, bool dumpAST) {
     }
   }
 
-  napkin::Parser parser(tokens);
+  // Installed before parsing so literal constants are counted too
+  std::unique_ptr<napkin::HeapProfiler> profiler;
+  if (options.heapStats) {
+    profiler.reset(new napkin::HeapProfiler(fileName));
+    profiler->setDumpInterval(options.heapStatsInterval);
+    napkin::heap()->setProfiler(profiler.get());
+  }
+
+  // Owns the AST (and bytecode) for the rest of the run
+  napkin::Arena arena;
+  // Created before resolving, which needs the names of the native functions
+  std::unique_ptr<napkin::Interpreter> interpreter;
+  std::unique_ptr<napkin::VM> vm;
+  std::vector<std::string> globalNames;
+  if (options.vm) {
+    vm.reset(new napkin::VM);
+    globalNames = vm->getGlobalNames();
+    if (options.maxDepth != 0) {
+      vm->setMaxDepth(options.maxDepth);
+    }
+  } else {
+    interpreter.reset(new napkin::Interpreter);
+    globalNames = interpreter->getGlobalNames();
+    if (options.jit) {
+      interpreter->enableJit();
+    }
+    if (!options.memo) {
+      interpreter->disableMemoization();
+    }
+  }
+  napkin::Parser parser(tokens, &arena);
   std::vector<napkin::Stmt *> stmts = parser.parse();
   if (parser.hadError) {
+    napkin::heap()->setProfiler(nullptr);
     return errno;
   }
-  if (dumpAST) {
+  napkin::ConstantFolder(&arena).fold(stmts);
+  napkin::Resolver(globalNames).resolve(stmts);
+  napkin::EscapeAnalyzer().analyze(stmts);
+  napkin::InvariantAnalyzer(&arena).analyze(stmts);
+  napkin::PurityAnalyzer(false).analyze(stmts);
+  if (options.dumpAST) {
     napkin::ASTPrinter astprinter;
     for (unsigned int i = 0; i < stmts.size(); i++) {
       std::cout << astprinter.visitStmt(stmts[i]) << std::endl;
     }
   }
 
-  napkin::Interpreter interpreter;
+  napkin::CompiledFunction *script = nullptr;
+  if (options.vm) {
+    try {
+      script = napkin::Compiler(&arena).compile(stmts);
+    } catch (napkin::CompileException &exception) {
+      std::cout << exception.what() << std::endl;
+      napkin::heap()->setProfiler(nullptr);
+      return errno;
+    }
+    if (options.dumpBytecode) {
+      script->disassemble(std::cout);
+    }
+  }
+
+  // The clock starts once the script is ready to run
+  napkin::ExecutionBudget &budget =
+      options.vm ? vm->getBudget() : interpreter->getBudget();
+  budget.setMaxSteps(options.maxSteps);
+  budget.setTimeout(options.timeout);
+
   try {
-    interpreter.interpret(stmts);
+    if (options.vm) {
+      vm->run(script);
+    } else if (options.closures) {
+      napkin::ClosureCompiler compiler(interpreter.get(), &arena);
+      std::vector<napkin::Code> program = compiler.compile(stmts);
+      compiler.run(program);
+    } else {
+      interpreter->interpret(stmts);
+    }
   } catch (napkin::RuntimeException &exception) {
     std::cout << exception.what() << std::endl;
   }
 
+  if (options.poolStats) {
+    printPoolStats();
+  }
+  if (options.quickenStats) {
+    napkin::TypeFeedback::printStats(std::cerr);
+  }
+  if (options.memoStats) {
+    napkin::MemoCache::printStats(std::cerr);
+  }
+  if (options.stepCount) {
+    std::cerr << "steps: " << budget.getSteps() << std::endl;
+  }
+  if (profiler) {
+    profiler->print(std::cerr);
+    napkin::heap()->setProfiler(nullptr);
+  }
   return 0;
 }
 
@@ -130,26 +353,76 @@ int main(int argc, char *argv[]) {
     runRepl();
   } else if (argc == 2) {
     std::string filename = argv[1];
-    return runFile(filename, false, false);
+    return runFile(filename, Options());
   } else if (argc > 2) {
     std::string filename = argv[1];
-    bool dumpAST = false;
-    bool dumpTokens = false;
+    Options options;
     // Parse command-line flags
     for (int i = 2; i < argc; i++) {
       if (std::strcmp(argv[i], "--dump-tokens") == 0) {
-        dumpTokens = true;
+        options.dumpTokens = true;
       } else if (std::strcmp(argv[i], "--dump-ast") == 0) {
-        dumpAST = true;
+        options.dumpAST = true;
+      } else if (std::strcmp(argv[i], "--vm") == 0) {
+        options.vm = true;
+      } else if (std::strcmp(argv[i], "--dump-bytecode") == 0) {
+        options.vm = true;
+        options.dumpBytecode = true;
+      } else if (std::strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+        // Deepest recursion the VM runs (implies vm)
+        options.vm = true;
+        options.maxDepth = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--closures") == 0) {
+        options.closures = true;
+      } else if (std::strcmp(argv[i], "--jit") == 0) {
+#if defined(__x86_64__)
+        options.jit = true;
+#else
+        std::cout << "Error: --jit is only supported on x86-64." << std::endl;
+        return errno;
+#endif
+      } else if (std::strcmp(argv[i], "--no-memo") == 0) {
+        options.memo = false;
+      } else if (std::strcmp(argv[i], "--memo-stats") == 0) {
+        options.memoStats = true;
+      } else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+        // Stop the run after so many statements and loop iterations
+        options.maxSteps = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) {
+        // Stop the run after so many milliseconds
+        options.timeout = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--step-count") == 0) {
+        options.stepCount = true;
+      } else if (std::strcmp(argv[i], "--pool-stats") == 0) {
+        options.poolStats = true;
+      } else if (std::strcmp(argv[i], "--quicken-stats") == 0) {
+        options.quickenStats = true;
+      } else if (std::strcmp(argv[i], "--heap-stats") == 0) {
+        options.heapStats = true;
+      } else if (std::strcmp(argv[i], "--heap-stats-interval") == 0 &&
+                 i + 1 < argc) {
+        // Also dump the heap profile every so many milliseconds
+        options.heapStats = true;
+        options.heapStatsInterval = std::stoul(argv[++i]);
+      } else if (std::strcmp(argv[i], "--gc-threshold") == 0 && i + 1 < argc) {
+        // Minimum heap size in bytes before the garbage collector runs
+        napkin::heap()->setThreshold(std::stoul(argv[++i]));
       } else {
         std::cout << "Error: unrecognized command line option: " << argv[i]
                   << std::endl;
+        printUsage();
         return errno;
       }
     }
-    return runFile(filename, dumpTokens, dumpAST);
+    if (options.vm && options.memoStats) {
+      std::cout << "Error: --memo-stats can't be used with --vm, which doesn't "
+                   "memoize calls."
+                << std::endl;
+      return errno;
+    }
+    return runFile(filename, options);
   } else {
-    std::cout << "Usage: napkin [filename]" << std::endl;
+    printUsage();
     return errno;
   }
 }
@@ -0,0 +1,95 @@
+#include "memo.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "nobject.h"
+
+namespace napkin {
+
+unsigned long MemoCache::totalHits = 0;
+unsigned long MemoCache::totalMisses = 0;
+
+bool MemoCache::lookup(Arguments arguments, unsigned long t_epoch,
+                       Value &result) {
+  if (epoch != t_epoch) {
+    // A variable the closure may read changed since the entries were stored
+    entries.clear();
+    hits = 0;
+    epoch = t_epoch;
+  }
+  probe.assign(arguments.begin(), arguments.end());
+  auto entry = entries.find(probe);
+  if (entry == entries.end()) {
+    totalMisses++;
+    return false;
+  }
+  hits++;
+  totalHits++;
+  result = entry->second;
+  return true;
+}
+
+void MemoCache::store(std::vector<Value> &arguments, unsigned long t_epoch,
+                      Value result) {
+  if (disabled) {
+    return;
+  }
+  if (epoch != t_epoch) {
+    entries.clear();
+    hits = 0;
+    epoch = t_epoch;
+  }
+  if (entries.size() >= MAX_ENTRIES) {
+    // The closure is never called twice with the same arguments
+    disabled = hits == 0;
+    entries.clear();
+    hits = 0;
+    if (disabled) {
+      return;
+    }
+  }
+  entries[arguments] = result;
+}
+
+void MemoCache::trace(Heap *heap) {
+  for (auto &entry : entries) {
+    for (unsigned long i = 0; i < entry.first.size(); i++) {
+      markValue(heap, entry.first[i]);
+    }
+    markValue(heap, entry.second);
+  }
+}
+
+/**
+ * Strings and complex numbers are left out: they are compared by contents,
+ * so identical arguments would rarely be the same object.
+ */
+bool MemoCache::isCacheable(Value value) {
+  return !value.isObject() || value.getType() == N_CALLABLE;
+}
+
+/**
+ * Mixes the bits of every argument (FNV-1a over 64 bit words).
+ */
+std::size_t MemoCache::ArgumentsHash::
+operator()(const std::vector<Value> &arguments) const {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned long i = 0; i < arguments.size(); i++) {
+    uint64_t bits;
+    std::memcpy(&bits, &arguments[i], sizeof(bits));
+    hash = (hash ^ bits) * 0x100000001b3;
+    hash ^= hash >> 32;
+  }
+  return (std::size_t)hash;
+}
+
+/**
+ * Prints how often memoized calls were found in their closure's cache.
+ */
+void MemoCache::printStats(std::ostream &out) {
+  out << "memoized calls: " << totalHits << " hits, " << totalMisses
+      << " misses" << std::endl;
+}
+
+} // namespace napkin
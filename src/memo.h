@@ -0,0 +1,66 @@
+#ifndef NAPKIN_MEMO_H_
+#define NAPKIN_MEMO_H_
+
+#include <cstddef>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "arguments.h"
+#include "heap.h"
+#include "value.h"
+
+namespace napkin {
+
+/**
+ * Results of earlier calls to a pure closure (see PurityAnalyzer), keyed on
+ * the bits of the arguments.
+ *
+ * Only numbers, booleans, nil and callables are cached, as arguments or
+ * results. Callables are compared by identity; the cache keeps them alive, so
+ * their addresses can't be reused while they are keys.
+ *
+ * Every entry is valid for one memo epoch of the interpreter, which moves on
+ * whenever a variable pure closures read is assigned. The cache holds at most
+ * MAX_ENTRIES and starts over when it is full, unless none of its entries
+ * were used, in which case it gives up on the closure for good.
+ */
+class MemoCache {
+public:
+  MemoCache() : epoch(0), hits(0), disabled(false){};
+
+  // Returns true and sets result if the call was memoized during the epoch
+  bool lookup(Arguments arguments, unsigned long t_epoch, Value &result);
+  void store(std::vector<Value> &arguments, unsigned long t_epoch,
+             Value result);
+  bool isDisabled() { return disabled; }
+
+  void trace(Heap *heap);
+
+  // True if a value can be an argument or the result of a memoized call
+  static bool isCacheable(Value value);
+
+  static const std::size_t MAX_ENTRIES = 1024;
+
+  // Memoized calls over the whole run
+  static unsigned long totalHits;
+  static unsigned long totalMisses;
+  static void printStats(std::ostream &out);
+
+private:
+  struct ArgumentsHash {
+    std::size_t operator()(const std::vector<Value> &arguments) const;
+  };
+
+  std::unordered_map<std::vector<Value>, Value, ArgumentsHash> entries;
+  // Key of the call being looked up, reused from one lookup to the next
+  std::vector<Value> probe;
+  unsigned long epoch;
+  // Hits since the cache was last emptied
+  unsigned long hits;
+  bool disabled;
+};
+
+} // namespace napkin
+
+#endif
@@ -4,6 +4,8 @@
 #include <chrono>
 #include <iostream>
 
+#include "environment.h"
+#include "heap.h"
 #include "nexception.h"
 #include "nobject.h"
 
@@ -25,12 +27,11 @@ public:
   virtual int arity() {
     return 0;
   }
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) {
+  virtual Value call(Interpreter *interpreter, Arguments arguments) {
     double ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                     std::chrono::system_clock::now().time_since_epoch())
                     .count();
-    return new NRealNumber(ms);
+    return Value(ms);
   }
   virtual std::string repr() { return "<native function millis>"; }
 };
@@ -43,11 +44,10 @@ public:
   virtual int arity() {
     return 0;
   }
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) {
+  virtual Value call(Interpreter *interpreter, Arguments arguments) {
     std::string input;
     std::getline(std::cin, input);
-    return new NString(input);
+    return Value(new NString(input));
   }
   virtual std::string repr() { return "<native function getline>"; }
 };
@@ -60,8 +60,7 @@ public:
   virtual int arity() {
     return 0;
   }
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) {
+  virtual Value call(Interpreter *interpreter, Arguments arguments) {
     std::exit(0);
   }
   virtual std::string repr() { return "<native function exit>"; }
@@ -76,17 +75,41 @@ public:
   virtual int arity() {
     return 1;
   }
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) {
-    if (arguments[0]->getType() != N_REAL_NUMBER) {
+  virtual Value call(Interpreter *interpreter, Arguments arguments) {
+    if (!arguments[0].isNumber()) {
       throw RuntimeException("exit_status requires real number argument");
     }
-    int status = ((NRealNumber *)arguments[0])->value;
+    int status = arguments[0].asNumber();
     std::exit(status);
   }
   virtual std::string repr() { return "<native function exit>"; }
 };
 
+/**
+ * Forces a garbage collection and returns the number of objects freed
+ */
+class CollectGarbageFunction : public NativeFunction {
+public:
+  virtual int arity() {
+    return 0;
+  }
+  virtual Value call(Interpreter *interpreter, Arguments arguments) {
+    return Value((double)heap()->collect());
+  }
+  virtual std::string repr() { return "<native function collect_garbage>"; }
+};
+
+/**
+ * Binds the native functions in a global environment.
+ */
+inline void defineNativeFunctions(Environment *globals) {
+  globals->bind("millis", Value(new MillisFunction));
+  globals->bind("getline", Value(new GetlineFunction));
+  globals->bind("exit", Value(new ExitFunction));
+  globals->bind("exit_status", Value(new ExitStatusFunction));
+  globals->bind("collect_garbage", Value(new CollectGarbageFunction));
+}
+
 } // namespace napkin
 
 #endif
@@ -1,43 +1,198 @@
 #include "nclosure.h"
 
+#include "closurecompiler.h"
+#include "jit.h"
+
 namespace napkin {
 
-NClosure::NClosure(LambdaExpr *t_expr, const Environment *t_environment) {
+/**
+ * Only the variables the body refers to are captured, so creating a closure
+ * costs as much as it has captures.
+ */
+NClosure::NClosure(LambdaExpr *t_expr, Environment *t_environment) {
   expr = t_expr;
-  // Create a new environment and copy over the environment passed in the
-  // contructor
-  environment = new Environment;
-  *environment = *t_environment;
+  globals = t_environment->root();
+  captures.reserve(expr->captures.size());
+  for (unsigned long i = 0; i < expr->captures.size(); i++) {
+    Capture &capture = expr->captures[i];
+    captures.push_back(
+        t_environment->ancestor(capture.depth)->capture(capture.slot));
+  }
+  // The closure's code must outlive it
+  expr->arena->retain();
+  memo = nullptr;
+}
+
+NClosure::~NClosure() {
+  delete memo;
+  expr->arena->release();
 }
 
 /**
  * Executes the function.
- * TODO
+ * Calls in tail position (see CallExpr::tail) are made here, after the call
+ * that requested them has returned, so tail recursion runs in a loop instead
+ * of growing the C++ stack.
+ * Calls to pure closures are memoized. Every call in a chain of tail calls
+ * returns the chain's result, so they are all stored once it is known.
+ */
+Value NClosure::call(Interpreter *interpreter, Arguments arguments) {
+  std::vector<PendingMemo> pending;
+  Value result;
+  if (recall(interpreter, arguments, pending, result)) {
+    return result;
+  }
+  result = run(interpreter, arguments);
+  if (!interpreter->isTailCalling()) {
+    memorize(interpreter, pending, result);
+    return result;
+  }
+
+  TempRootScope scope(interpreter->tempRoots);
+  while (interpreter->isTailCalling()) {
+    // Keeps the closure being jumped to and its arguments alive
+    ArgumentScope tailArguments(interpreter->argumentStack);
+    TailCall tailCall = interpreter->takeTailCall();
+    AllocationSite site(*tailCall.site);
+    NCallable *function = (NCallable *)tailCall.callee.asObject();
+    NClosure *closure = function->asClosure();
+    if (closure == nullptr) {
+      // Native functions never request tail calls
+      interpreter->noteSideEffect();
+      return function->call(interpreter, tailCall.arguments);
+    }
+    unsigned long memos = pending.size();
+    if (closure->recall(interpreter, tailCall.arguments, pending, result)) {
+      break;
+    }
+    if (pending.size() != memos) {
+      // Keeps the closure and the key of its pending memo alive
+      interpreter->tempRoots.push_back(tailCall.callee);
+      for (unsigned long i = 0; i < tailCall.arguments.size(); i++) {
+        interpreter->tempRoots.push_back(tailCall.arguments[i]);
+      }
+    }
+    result = closure->run(interpreter, tailCall.arguments);
+  }
+  memorize(interpreter, pending, result);
+  return result;
+}
+
+/**
+ * Runs the body once. Leaves a tail call the body requested to the caller.
  */
-NObject *NClosure::call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) {
-  Environment *tempEnvironment = new Environment(this->environment);
+Value NClosure::run(Interpreter *interpreter, Arguments arguments) {
+  interpreter->checkStack();
+  if (!expr->pure) {
+    interpreter->noteSideEffect();
+  }
+  if (interpreter->isJitEnabled()) {
+    // Native code never raises the returning signal
+    Value result;
+    if (runNative(this, arguments, result)) {
+      return result;
+    }
+  }
+
+  // Temporaries that can't escape the call are freed when it returns
+  CallRegion region;
+  Environment *tempEnvironment =
+      interpreter->acquireFrame(globals, expr->body->slotCount);
+  bindCaptures(tempEnvironment);
   // Match parameters with arguments
   for (unsigned long i = 0; i < arguments.size(); i++) {
-    tempEnvironment->declareVar(expr->parameters[i]->token.getLexeme(),
-                                arguments[i]);
+    Identifier *parameter = expr->parameters[i];
+    if (parameter->boxed) {
+      tempEnvironment->declareBoxed(
+          parameter->slot, parameter->token.getLexeme(), arguments[i]);
+    } else {
+      tempEnvironment->declareSlot(
+          parameter->slot, parameter->token.getLexeme(), arguments[i]);
+    }
   }
 
   // Either get the resulting value from executing to the end of the block stmt
-  // or from a return stmt that throws a ReturnException
-  NObject *result = nullptr;
-  try {
+  // or from a return stmt that stopped it early
+  Value result;
+  if (expr->code != nullptr) {
+    // Compiled by the ClosureCompiler
+    result = expr->code->body(tempEnvironment);
+  } else {
     result = interpreter->executeBlockStmt(expr->body, tempEnvironment);
-  } catch (ReturnException returnValue) {
-    result = returnValue.value;
+  }
+  if (interpreter->isReturning() && !interpreter->isTailCalling()) {
+    result = interpreter->takeReturnValue();
   }
 
-  delete tempEnvironment;
+  interpreter->releaseFrame(tempEnvironment);
   return result;
 }
 
+/**
+ * Looks a call up in the closure's memo cache. On a miss, the call is added to
+ * the pending ones if it can be memoized.
+ */
+bool NClosure::recall(Interpreter *interpreter, Arguments arguments,
+                      std::vector<PendingMemo> &pending, Value &result) {
+  if (!expr->pure || !interpreter->isMemoizing() ||
+      pending.size() >= MAX_PENDING_MEMOS) {
+    return false;
+  }
+  for (unsigned long i = 0; i < arguments.size(); i++) {
+    if (!MemoCache::isCacheable(arguments[i])) {
+      return false;
+    }
+  }
+  if (memo == nullptr) {
+    memo = new MemoCache;
+  } else if (memo->isDisabled()) {
+    return false;
+  }
+  if (memo->lookup(arguments, interpreter->getMemoEpoch(), result)) {
+    return true;
+  }
+  std::vector<Value> key(arguments.begin(), arguments.end());
+  pending.push_back({this, key, interpreter->getSideEffects()});
+  return false;
+}
+
+/**
+ * Stores the result of the pending calls. Calls that had side effects (see
+ * Interpreter::noteSideEffect) aren't stored, and their lambdas stop being
+ * memoized.
+ */
+void NClosure::memorize(Interpreter *interpreter,
+                        std::vector<PendingMemo> &pending, Value result) {
+  bool cacheable = MemoCache::isCacheable(result);
+  for (unsigned long i = 0; i < pending.size(); i++) {
+    PendingMemo &call = pending[i];
+    if (call.sideEffects != interpreter->getSideEffects()) {
+      call.closure->expr->pure = false;
+    } else if (cacheable) {
+      call.closure->memo->store(call.arguments, interpreter->getMemoEpoch(),
+                                result);
+    }
+  }
+}
+
+void NClosure::bindCaptures(Environment *frame) {
+  for (unsigned long i = 0; i < captures.size(); i++) {
+    frame->setSlot(expr->captures[i].frameSlot, Value(captures[i]));
+  }
+}
+
 int NClosure::arity() {
   return expr->parameters.size();
 }
 
+void NClosure::trace(Heap *heap) {
+  heap->mark(globals);
+  for (unsigned long i = 0; i < captures.size(); i++) {
+    heap->mark(captures[i]);
+  }
+  if (memo != nullptr) {
+    memo->trace(heap);
+  }
+}
+
 }
@@ -3,23 +3,67 @@
 
 #include "AST.h"
 #include "environment.h"
+#include "memo.h"
 #include "nobject.h"
 
 #include "interpreter.h"
 
 namespace napkin {
 
+/**
+ * A lambda together with the cells of the variables it captures (see
+ * LambdaExpr::captures). Globals are looked up by name in the global
+ * environment the closure was created in.
+ */
 class NClosure : public NCallable {
 public:
-  NClosure(LambdaExpr *t_expr, const Environment *t_environment);
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments);
+  // Captures the lambda's free variables from the environment it is created
+  // in
+  NClosure(LambdaExpr *t_expr, Environment *t_environment);
+  ~NClosure();
+  virtual Value call(Interpreter *interpreter, Arguments arguments);
   virtual int arity();
   virtual std::string repr() { return "<closure>"; }
+  virtual void trace(Heap *heap);
+  virtual NClosure *asClosure() { return this; }
+
+  LambdaExpr *getExpr() { return expr; }
+  Environment *getGlobals() { return globals; }
+  // Value of a captured variable, undefined if it isn't declared yet
+  Value getCapture(unsigned long index) { return captures[index]->value; }
+
+  // Puts the captured cells in their slots of a new call frame
+  void bindCaptures(Environment *frame);
 
 private:
+  /**
+   * A memoized call whose result is stored once its chain of tail calls
+   * returns.
+   */
+  struct PendingMemo {
+    NClosure *closure;
+    std::vector<Value> arguments;
+    // Calls with side effects made before this one started
+    unsigned long sideEffects;
+  };
+
+  Value run(Interpreter *interpreter, Arguments arguments);
+
+  // Memoization of pure closures
+  bool recall(Interpreter *interpreter, Arguments arguments,
+              std::vector<PendingMemo> &pending, Value &result);
+  static void memorize(Interpreter *interpreter,
+                       std::vector<PendingMemo> &pending, Value result);
+
+  // Calls in a chain of tail calls that are memoized at most
+  static const unsigned long MAX_PENDING_MEMOS = 16;
+
   LambdaExpr *expr; // The actual "contents" of the function 
-  Environment *environment; 
+  Environment *globals;
+  // Cells of the captured variables, in the order of LambdaExpr::captures
+  std::vector<Cell *> captures;
+  // Created by the first memoized call
+  MemoCache *memo;
 };
 
 } // namespace napkin
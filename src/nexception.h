@@ -4,7 +4,7 @@
 #include <exception>
 #include <string>
 
-#include "nobject.h"
+#include "value.h"
 
 namespace napkin {
 
@@ -42,18 +42,36 @@ public:
   };
 };
 
+class CompileException : public NException {
+public:
+  CompileException(std::string t_message) : NException(t_message) {
+    std::string message_prefix = "Napkin CompileException: ";
+    message = message_prefix + message;
+  };
+};
+
 /**
- * Used to jump through C++ call stack to return from a C++ function
- * @param t_value The value (a napkin object) to be returned
+ * Thrown when a return statement runs outside of any function. Returns from
+ * functions don't throw (see Interpreter::visitReturnStmt).
+ * @param t_value The napkin value that was returned
  */
 class ReturnException : public RuntimeException {
 public:
-  ReturnException(NObject *t_value)
+  ReturnException(Value t_value)
       : RuntimeException(
             "Napkin ReturnException: returned from outside a function."),
         value(t_value){};
 
-  NObject *value;
+  Value value;
+};
+
+/**
+ * Thrown when a run uses up its step or time budget (see ExecutionBudget).
+ */
+class BudgetExceededException : public RuntimeException {
+public:
+  BudgetExceededException(std::string t_message)
+      : RuntimeException(t_message){};
 };
 
 /**
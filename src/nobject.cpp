@@ -0,0 +1,106 @@
+#include "nobject.h"
+
+#include <cstdio>
+#include <utility>
+
+namespace napkin {
+
+/**
+ * Returns true if a value represents the empty string.
+ * Everything that isn't a string has a non-empty representation.
+ */
+static bool isEmptyString(Value value) {
+  return value.getType() == N_STRING &&
+         ((NString *)value.asObject())->isEmpty();
+}
+
+/**
+ * Returns true if a value is destroyed when the current call returns.
+ */
+static bool isInRegion(Value value) {
+  return value.isObject() && heap()->isInRegion(value.asObject());
+}
+
+/**
+ * Appends a number formatted like std::to_string without creating a temporary
+ * string.
+ */
+static void appendNumber(std::string &text, double number) {
+  char buffer[64];
+  int length = std::snprintf(buffer, sizeof(buffer), "%f", number);
+  if (length < 0 || length >= (int)sizeof(buffer)) {
+    text += std::to_string(number);
+    return;
+  }
+  text.append(buffer, length);
+}
+
+NString::NString(std::string t_value) : value(t_value) {
+  flat = true;
+  empty = value.empty();
+}
+
+NString::NString(Value t_left, Value t_right) : left(t_left), right(t_right) {
+  flat = false;
+  empty = isEmptyString(left) && isEmptyString(right);
+  // A string on the collected heap must not refer to objects that are freed
+  // when the current call's region is released
+  if (!heap()->isInRegion(this) && (isInRegion(left) || isInRegion(right))) {
+    flatten();
+  }
+}
+
+std::string NString::repr() {
+  if (!flat) {
+    flatten();
+  }
+  return value;
+}
+
+bool NString::isEmpty() {
+  return empty;
+}
+
+void NString::trace(Heap *heap) {
+  if (!flat) {
+    markValue(heap, left);
+    markValue(heap, right);
+  }
+}
+
+/**
+ * Assembles the text of a concatenation and keeps it, dropping the pieces.
+ * Walks the rope with an explicit stack since long chains of concatenations
+ * would overflow the C++ stack.
+ */
+void NString::flatten() {
+  std::string text;
+  std::vector<Value> pending;
+  pending.push_back(right);
+  pending.push_back(left);
+  while (!pending.empty()) {
+    Value piece = pending.back();
+    pending.pop_back();
+
+    if (piece.isNumber()) {
+      appendNumber(text, piece.asNumber());
+    } else if (piece.getType() == N_STRING) {
+      NString *string = (NString *)piece.asObject();
+      if (string->flat) {
+        text += string->value;
+      } else {
+        pending.push_back(string->right);
+        pending.push_back(string->left);
+      }
+    } else {
+      text += piece.repr();
+    }
+  }
+
+  value = std::move(text);
+  left = Value();
+  right = Value();
+  flat = true;
+}
+
+} // namespace napkin
@@ -4,54 +4,31 @@
 #include <string>
 #include <vector>
 
+#include "arguments.h"
+#include "heap.h"
+#include "value.h"
 
 /**
  * C++ representations of objects in the napkin language.
+ * Real numbers, booleans and null are stored directly inside a Value; only the
+ * types below need to live on the heap.
  */
 
 namespace napkin {
 
 // Forward declare Interpreter class
 class Interpreter;
+class NClosure;
 
 /**
- * All possible types of objects in the napkin language.
+ * Base class for all heap allocated napkin objects.
+ * All napkin objects live on the garbage collected heap.
  */
-enum NType {
-  N_REAL_NUMBER,
-  N_COMPLEX_NUMBER,
-  N_BOOLEAN,
-  N_STRING,
-  N_CALLABLE,
-};
-
-/**
- * Base class for all napkin objects.
- */
-class NObject {
+class NObject : public HeapObject {
 public:
-  virtual NType getType() {
-    return type;
-  }
+  virtual NType getType() = 0;
   // Like python's __repr__()
   virtual std::string repr() = 0;
-protected:
-  NType type; // Store runtime type information
-};
-
-/**
- * Real numbers.
- */
-class NRealNumber : public NObject {
-public:
-  NRealNumber(double t_value) : value(t_value) {
-    type = N_REAL_NUMBER;
-  };
-  double value;
-
-  virtual std::string repr() {
-    return std::to_string(value);
-  }
 };
 
 /**
@@ -59,12 +36,12 @@ public:
  */
 class NComplexNumber : public NObject {
 public:
-  NComplexNumber(double t_re, double t_im) : re(t_re), im(t_im) {
-    type = N_COMPLEX_NUMBER;
-  }
+  NComplexNumber(double t_re, double t_im) : re(t_re), im(t_im) {}
   double re;
   double im;
 
+  virtual NType getType() { return N_COMPLEX_NUMBER; }
+  virtual const char *getTypeName() { return "complex number"; }
   virtual std::string repr() {
     std::string re_str = std::to_string(re);
     std::string im_str = std::to_string(im);
@@ -72,34 +49,36 @@ public:
   }
 };
 
-/**
- * Booleans.
- */
-class NBoolean : public NObject {
-public:
-  NBoolean(bool t_value) : value(t_value) {
-    type = N_BOOLEAN;
-  }
-  bool value;
-
-  virtual std::string repr() {
-    return (value ? "true" : "false");
-  }
-};
-
 /**
  * Strings.
+ * A string is either flat text or the concatenation of two values (a rope),
+ * so building a string piece by piece never copies what was built so far.
+ * The text of a concatenation is only assembled when it is needed and the
+ * node then becomes flat.
  */
 class NString : public NObject {
 public:
-  NString(std::string t_value) : value(t_value) {
-    type = N_STRING;
-  }
-  std::string value;
+  NString(std::string t_value);
+  // Concatenation of the representations of two values
+  NString(Value t_left, Value t_right);
 
-  virtual std::string repr() {
-    return value;
-  }
+  virtual NType getType() { return N_STRING; }
+  virtual const char *getTypeName() { return "string"; }
+  virtual std::string repr();
+  bool isEmpty();
+
+  virtual void trace(Heap *heap);
+
+private:
+  void flatten();
+
+  // Text of the string once it is flat
+  std::string value;
+  // Pieces of a concatenation that hasn't been flattened yet
+  Value left;
+  Value right;
+  bool flat;
+  bool empty;
 };
 
 /**
@@ -107,24 +86,12 @@ public:
  */
 class NCallable : public NObject {
 public:
-  NCallable() {
-    type = N_CALLABLE;
-  }
-  virtual NObject *call(Interpreter *interpreter,
-                        std::vector<NObject *> arguments) = 0;
+  virtual NType getType() { return N_CALLABLE; }
+  virtual const char *getTypeName() { return "callable"; }
+  virtual Value call(Interpreter *interpreter, Arguments arguments) = 0;
   virtual int arity() = 0;
-};
-
-/**
- * Null type.
- */
-class NNullType : public NObject {
-public:
-  NNullType() {};
-
-  virtual std::string repr() {
-    return "null";
-  }
+  // Returns the closure if the callable is written in napkin
+  virtual NClosure *asClosure() { return nullptr; }
 };
 
 } // namespace napkin
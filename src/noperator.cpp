@@ -5,81 +5,62 @@
 namespace napkin {
 
 /**
- * Adds two napkin numbers (complex or real).
- * Will cast up to complex.
+ * Returns the real part of a numeric value (real or complex).
  */
-NObject *nAdd(NObject *left, NObject* right) {
-  // If at least one of the operands are strings, do string concatenation
-  if (left->getType() == N_STRING || right->getType() == N_STRING) {
-    std::string leftString = left->repr();
-    std::string rightString = right->repr();
-    return new NString(leftString + rightString);
+static double realPart(Value value) {
+  if (value.isNumber()) {
+    return value.asNumber();
   }
+  return ((NComplexNumber *)value.asObject())->re;
+}
 
-  // Not a number
-  if ((left->getType() != N_REAL_NUMBER &&
-       left->getType() != N_COMPLEX_NUMBER) ||
-      (right->getType() != N_REAL_NUMBER &&
-       right->getType() != N_COMPLEX_NUMBER)) {
-    RuntimeException ex("Invalid operands for addition/subtraction.");
-    throw ex;
+/**
+ * Returns the imaginary part of a numeric value (real or complex).
+ */
+static double imaginaryPart(Value value) {
+  if (value.isNumber()) {
+    return 0;
   }
+  return ((NComplexNumber *)value.asObject())->im;
+}
 
+/**
+ * Adds two napkin numbers (complex or real).
+ * Will cast up to complex.
+ */
+Value nAdd(Value left, Value right) {
   // Both real numbers
-  if (left->getType() == N_REAL_NUMBER && right->getType() == N_REAL_NUMBER) {
-    double result =
-        ((NRealNumber *)left)->value + ((NRealNumber *)right)->value;
-    return new NRealNumber(result);
+  if (left.isNumber() && right.isNumber()) {
+    return Value(left.asNumber() + right.asNumber());
   }
 
-  // Left real, right complex
-  if (left->getType() == N_REAL_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    double left_value = ((NRealNumber *)left)->value;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
-
-    double result_re = left_value + right_re;
-    double result_im = right_im;
-
-    return new NComplexNumber(result_re, result_im);
+  // If at least one of the operands are strings, do string concatenation
+  // The operands are only converted to text once the result is needed
+  if (left.getType() == N_STRING || right.getType() == N_STRING) {
+    return Value(new NString(left, right));
   }
 
-  // Left complex, right real
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_REAL_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_value = ((NRealNumber *)right)->value;
-
-    double result_re = left_re + right_value;
-    double result_im = left_im;
-
-    return new NComplexNumber(result_re, result_im);
+  // Not a number
+  if (!isNumeric(left) || !isNumeric(right)) {
+    RuntimeException ex("Invalid operands for addition/subtraction.");
+    throw ex;
   }
 
-  // Both complex
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
-
-    double result_re = left_re + right_re;
-    double result_im = left_im + right_im;
+  // At least one operand is complex
+  double result_re = realPart(left) + realPart(right);
+  double result_im = imaginaryPart(left) + imaginaryPart(right);
 
-    return new NComplexNumber(result_re, result_im);
-  }
-
-  // Unreachable
-  return nullptr;
+  return Value(new NComplexNumber(result_re, result_im));
 }
 
 /**
  * Same as nAdd.
  */
-NObject *nSubtract(NObject *left, NObject* right) {
+Value nSubtract(Value left, Value right) {
+  // Both real numbers
+  if (left.isNumber() && right.isNumber()) {
+    return Value(left.asNumber() - right.asNumber());
+  }
   return nAdd(left, nNegate(right));
 }
 
@@ -87,108 +68,73 @@ NObject *nSubtract(NObject *left, NObject* right) {
  * Returns the negative of a number.
  * Preserves type (real or complex).
  */
-NObject *nNegate(NObject *right) {
+Value nNegate(Value right) {
+  // Real number
+  if (right.isNumber()) {
+    return Value(-right.asNumber());
+  }
+
   // Not a number
-  if (right->getType() != N_REAL_NUMBER &&
-      right->getType() != N_COMPLEX_NUMBER) {
+  if (!isComplexNumber(right)) {
     RuntimeException ex("Invalid operand for unary negation.");
     throw ex;
   }
 
-  // Real number
-  if (right->getType() == N_REAL_NUMBER) {
-    double result = - (((NRealNumber *)right)->value);
-    return new NRealNumber(result);
-  }
-
   // Complex number
-  if (right->getType() == N_COMPLEX_NUMBER) {
-    double result_re = - (((NComplexNumber *)right)->re);
-    double result_im = - (((NComplexNumber *)right)->im);
-    return new NComplexNumber(result_re, result_im);
-  }
-
-  // Unreachable
-  return nullptr;
+  double result_re = -realPart(right);
+  double result_im = -imaginaryPart(right);
+  return Value(new NComplexNumber(result_re, result_im));
 }
 
 /**
  * Multiplies two napkin numbers (complex or real).
  * Will cast up to complex.
  */
-NObject *nMultiply(NObject *left, NObject *right) {
+Value nMultiply(Value left, Value right) {
+  // Both real numbers
+  if (left.isNumber() && right.isNumber()) {
+    return Value(left.asNumber() * right.asNumber());
+  }
+
   // Not a number
-  if ((left->getType() != N_REAL_NUMBER &&
-       left->getType() != N_COMPLEX_NUMBER) ||
-      (right->getType() != N_REAL_NUMBER &&
-       right->getType() != N_COMPLEX_NUMBER)) {
+  if (!isNumeric(left) || !isNumeric(right)) {
     RuntimeException ex("Invalid operands for multiplication/division.");
     throw ex;
   }
 
-  // Both real numbers
-  if (left->getType() == N_REAL_NUMBER && right->getType() == N_REAL_NUMBER) {
-    double result =
-        ((NRealNumber *)left)->value * ((NRealNumber *)right)->value;
-    return new NRealNumber(result);
-  }
+  double left_re = realPart(left);
+  double left_im = imaginaryPart(left);
+  double right_re = realPart(right);
+  double right_im = imaginaryPart(right);
 
   // Left real, right complex
-  if (left->getType() == N_REAL_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    double left_value = ((NRealNumber *)left)->value;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
-
-    double result_re = left_value * right_re;
-    double result_im = left_value * right_im;
-
-    return new NComplexNumber(result_re, result_im);
+  if (left.isNumber()) {
+    return Value(new NComplexNumber(left_re * right_re, left_re * right_im));
   }
 
   // Left complex, right real
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_REAL_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_value = ((NRealNumber *)right)->value;
-
-    double result_re = left_re * right_value;
-    double result_im = left_im * right_value;
-
-    return new NComplexNumber(result_re, result_im);
+  if (right.isNumber()) {
+    return Value(new NComplexNumber(left_re * right_re, left_im * right_re));
   }
 
   // Both complex
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
+  double result_re = left_re * right_re - left_im * right_im;
+  double result_im = left_re * right_im + left_im * right_re;
 
-    double result_re = left_re * right_re - left_im * right_im;
-    double result_im = left_re * right_im + left_im * right_re;
-
-    return new NComplexNumber(result_re, result_im);
-  }
-
-  // Unreachable
-  return nullptr;
+  return Value(new NComplexNumber(result_re, result_im));
 }
 
 /**
  * Multiplies a number by 'j1'
  */
-NObject *nJ(NObject *right) {
+Value nJ(Value right) {
   // Not a number
-  if (right->getType() != N_REAL_NUMBER &&
-      right->getType() != N_COMPLEX_NUMBER) {
+  if (!isNumeric(right)) {
     RuntimeException ex("Invalid operand for unary negation.");
     throw ex;
   }
   NComplexNumber multiplier(0, 1);
-  return nMultiply(&multiplier, right);
+  return nMultiply(Value(&multiplier), right);
 }
 
 
@@ -196,122 +142,189 @@ NObject *nJ(NObject *right) {
  * Divides two napkin numbers (complex or real).
  * Will cast up to complex.
  */
-NObject *nDivide(NObject *left, NObject *right) {
+Value nDivide(Value left, Value right) {
+  // Both real numbers
+  if (left.isNumber() && right.isNumber()) {
+    return Value(left.asNumber() / right.asNumber());
+  }
+
   // Not a number
-  if ((left->getType() != N_REAL_NUMBER &&
-       left->getType() != N_COMPLEX_NUMBER) ||
-      (right->getType() != N_REAL_NUMBER &&
-       right->getType() != N_COMPLEX_NUMBER)) {
+  if (!isNumeric(left) || !isNumeric(right)) {
     RuntimeException ex("Invalid operands for multiplication/division.");
     throw ex;
   }
 
-  // Both real numbers
-  if (left->getType() == N_REAL_NUMBER && right->getType() == N_REAL_NUMBER) {
-    double result =
-        ((NRealNumber *)left)->value / ((NRealNumber *)right)->value;
-    return new NRealNumber(result);
-  }
+  double left_re = realPart(left);
+  double left_im = imaginaryPart(left);
 
   // Left complex, right real
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_REAL_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_value = ((NRealNumber *)right)->value;
+  if (right.isNumber()) {
+    double right_value = right.asNumber();
+    return Value(
+        new NComplexNumber(left_re / right_value, left_im / right_value));
+  }
 
-    double result_re = left_re / right_value;
-    double result_im = left_im / right_value;
+  // Right complex (a real left operand is treated as complex)
+  double right_re = realPart(right);
+  double right_im = imaginaryPart(right);
 
-    return new NComplexNumber(result_re, result_im);
-  }
+  double result_re = left_re * right_re + left_im * right_im;
+  double result_im = -(left_re * right_im) + (right_re * left_im);
 
-  // Left real, right complex
-  if (left->getType() == N_REAL_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    // Cast left to a complex number and perform the division
-    NComplexNumber temp_left(((NRealNumber *)left)->value, 0);
-    return nDivide(&temp_left, right);
-  }
+  double divisor = pow(right_re, 2) + pow(right_im, 2);
+  result_re = result_re / divisor;
+  result_im = result_im / divisor;
 
-  // Both complex
-  if (left->getType() == N_COMPLEX_NUMBER &&
-      right->getType() == N_COMPLEX_NUMBER) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
+  return Value(new NComplexNumber(result_re, result_im));
+}
 
-    double result_re = left_re * right_re + left_im * right_im;
-    double result_im = -(left_re * right_im) + (right_re * left_im);
+// Largest exponent computed by squaring rather than with pow()
+static const double MAX_SQUARING_EXPONENT = 64;
 
-    double divisor = pow(right_re, 2) + pow(right_im, 2);
-    result_re = result_re / divisor;
-    result_im = result_im / divisor;
+/**
+ * Returns true if an exponent is small and integral enough to be computed by
+ * squaring.
+ */
+static bool isSmallInteger(double exponent) {
+  return exponent == std::floor(exponent) &&
+         std::fabs(exponent) <= MAX_SQUARING_EXPONENT;
+}
 
-    return new NComplexNumber(result_re, result_im);
+/**
+ * Raises a real number to a real power.
+ * Integral powers of -1 only depend on the parity of the exponent, and small
+ * integral powers are computed by squaring. 0**0 is 1.
+ */
+static double realPower(double base, double exponent) {
+  if (base == -1 && exponent == std::floor(exponent) &&
+      std::isfinite(exponent)) {
+    return std::fmod(exponent, 2) == 0 ? 1 : -1;
+  }
+  if (!isSmallInteger(exponent)) {
+    return pow(base, exponent);
   }
 
-  // Unreachable
-  return nullptr;
+  unsigned long n = (unsigned long)std::fabs(exponent);
+  double result = 1;
+  double square = base;
+  while (n != 0) {
+    if (n & 1) {
+      result *= square;
+    }
+    square *= square;
+    n >>= 1;
+  }
+  return exponent < 0 ? 1 / result : result;
+}
+
+/**
+ * Raises a complex number to a small integral power by squaring, which keeps
+ * results like j1**2 exact.
+ */
+static NComplexNumber *complexIntegerPower(double re, double im,
+                                           double exponent) {
+  unsigned long n = (unsigned long)std::fabs(exponent);
+  double result_re = 1;
+  double result_im = 0;
+  while (n != 0) {
+    if (n & 1) {
+      double next_re = result_re * re - result_im * im;
+      result_im = result_re * im + result_im * re;
+      result_re = next_re;
+    }
+    double next_re = re * re - im * im;
+    im = 2 * re * im;
+    re = next_re;
+    n >>= 1;
+  }
+  if (exponent < 0) {
+    double divisor = result_re * result_re + result_im * result_im;
+    return new NComplexNumber(result_re / divisor, -result_im / divisor);
+  }
+  return new NComplexNumber(result_re, result_im);
 }
 
 /**
  * Raises left to the power of right.
- * TODO: support exponentiation of complex numbers
+ * Both operands may be real or complex. Powers of real numbers by real numbers
+ * are real (NaN for a fractional power of a negative number, like pow()), any
+ * other power is complex and computed in polar form:
+ * (r e^(j theta))**(c + jd) = e^(c ln(r) - d theta) e^(j (d ln(r) + c theta))
  */
-NObject *nPower(NObject *left, NObject *right) {
-  if (!areRealNumbers(left, right)) {
+Value nPower(Value left, Value right) {
+  if (areRealNumbers(left, right)) {
+    return Value(realPower(left.asNumber(), right.asNumber()));
+  }
+
+  // Not a number
+  if (!isNumeric(left) || !isNumeric(right)) {
     throw RuntimeException("invalid operands for exponentiation.");
   }
 
-  double left_value = ((NRealNumber *)left)->value;
-  double right_value = ((NRealNumber *)right)->value;
+  double left_re = realPart(left);
+  double left_im = imaginaryPart(left);
+  double right_re = realPart(right);
+  double right_im = imaginaryPart(right);
+
+  // Before the integer powers, whose negative powers of 0 would be NaN
+  if (left_re == 0 && left_im == 0) {
+    // 0**w is 1 for w = 0 (like pow()), 0 if the real part of w is positive,
+    // undefined otherwise
+    if (right_re == 0 && right_im == 0) {
+      return Value(new NComplexNumber(1, 0));
+    }
+    if (right_re <= 0) {
+      throw RuntimeException("can't raise zero to a power whose real part "
+                             "isn't positive.");
+    }
+    return Value(new NComplexNumber(0, 0));
+  }
 
-  if (left_value == 0 && right_value == 0) {
-    throw RuntimeException("can't raise zero to the power of zero!");
+  if (right_im == 0 && isSmallInteger(right_re)) {
+    return Value(complexIntegerPower(left_re, left_im, right_re));
   }
-  
-  return new NRealNumber(pow(left_value, right_value));
+
+  double log_r = std::log(std::hypot(left_re, left_im));
+  double theta = std::atan2(left_im, left_re);
+  double magnitude = std::exp(right_re * log_r - right_im * theta);
+  double angle = right_im * log_r + right_re * theta;
+  return Value(new NComplexNumber(magnitude * std::cos(angle),
+                                  magnitude * std::sin(angle)));
 }
 
 /**
  * Returns the logical "not" of an expression
- * Casts to nBoolean
+ * Casts to boolean
  */
-NObject *nNot(NObject *right) {
-  return new NBoolean(!isTruthy(right));
+Value nNot(Value right) {
+  return Value::boolean(!isTruthy(right));
 }
 
 /**
- * Returns true if a napkin object is considered truthy
+ * Returns true if a napkin value is considered truthy
  */
-bool isTruthy(NObject *object) {
-  switch (object->getType()) {
+bool isTruthy(Value object) {
+  switch (object.getType()) {
   case N_REAL_NUMBER:
     // Only 0 is false
-    if (((NRealNumber *)object)->value == 0) {
-      return false;
-    }
-    return true;
+    return object.asNumber() != 0;
     break;
 
   case N_COMPLEX_NUMBER:
     // Only 0+j0 is false
-    if (((NComplexNumber *)object)->re == 0 &&
-        ((NComplexNumber *)object)->im == 0) {
+    if (realPart(object) == 0 && imaginaryPart(object) == 0) {
       return false;
     }
     return true;
     break;
 
   case N_BOOLEAN:
-    return ((NBoolean *)object)->value;
+    return object.asBoolean();
     break;
 
   case N_STRING:
     // Empty string is false
-    if (((NString *)object)->value.empty()) {
+    if (((NString *)object.asObject())->isEmpty()) {
       return false;
     }
     return true;
@@ -319,15 +332,21 @@ bool isTruthy(NObject *object) {
   case N_CALLABLE:
     return true;
     break;
+  case N_NULL:
+    return false;
+    break;
   }
+
+  // Unreachable
+  return false;
 }
 
 /**
  * Returns napkin true if either left or right is truthy.
  */
-NObject *nLogicalOr(NObject *left, NObject *right) {
+Value nLogicalOr(Value left, Value right) {
   try {
-    return new NBoolean(isTruthy(left) || isTruthy(right));
+    return Value::boolean(isTruthy(left) || isTruthy(right));
   }
   catch (RuntimeException &e) {
     throw RuntimeException("Invalid operands for logical 'or'.");
@@ -337,9 +356,9 @@ NObject *nLogicalOr(NObject *left, NObject *right) {
 /**
  * Returns napkin true if both left and right are truthy.
  */
-NObject *nLogicalAnd(NObject *left, NObject *right) {
+Value nLogicalAnd(Value left, Value right) {
   try {
-    return new NBoolean(isTruthy(left) && isTruthy(right));
+    return Value::boolean(isTruthy(left) && isTruthy(right));
   }
   catch (RuntimeException &e) {
     throw RuntimeException("Invalid operands for logical 'and'.");
@@ -347,193 +366,143 @@ NObject *nLogicalAnd(NObject *left, NObject *right) {
 }
 
 /**
- * Returns NBoolean with value true if left and right are considered equal
+ * Returns boolean true if left and right are considered equal
  */
-NObject *nLogicalEqual(NObject *left, NObject *right) {
-  NType left_type = left->getType();
-  NType right_type = right->getType();
-
-  // Either operand is boolean
-  if (left_type == N_BOOLEAN || right_type == N_BOOLEAN) {
-    bool left_value = isTruthy(left);
-    bool right_value = isTruthy(right);
-    if (left_value ==  right_value) {
-      return new NBoolean(true);
-    }
-    return new NBoolean(false);
-  }
-
+Value nLogicalEqual(Value left, Value right) {
   // Both real numbers
   if (areRealNumbers(left, right)) {
-    double left_value = ((NRealNumber *)left)->value;
-    double right_value = ((NRealNumber *)right)->value;
-
-    return new NBoolean(left_value == right_value);
+    return Value::boolean(left.asNumber() == right.asNumber());
   }
 
-  // Left real, right complex
-  if (left_type == N_REAL_NUMBER && right_type == N_COMPLEX_NUMBER) {
-    double left_value = ((NRealNumber *)left)->value;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
-
-    // If complex number has imaginary part, it cannot equal a real number
-    if (right_im != 0) {
-      return new NBoolean(false);
-    }
-
-    return new NBoolean(left_value == right_re);
-  }
-
-  // Left complex, right real
-  if (left_type == N_COMPLEX_NUMBER && right_type == N_REAL_NUMBER) {
-    return nLogicalEqual(right, left);
+  // Either operand is boolean
+  if (left.isBoolean() || right.isBoolean()) {
+    bool left_value = isTruthy(left);
+    bool right_value = isTruthy(right);
+    return Value::boolean(left_value == right_value);
   }
 
-  // Both complex
-  if (areComplexNumbers(left, right)) {
-    double left_re = ((NComplexNumber *)left)->re;
-    double left_im = ((NComplexNumber *)left)->im;
-    double right_re = ((NComplexNumber *)right)->re;
-    double right_im = ((NComplexNumber *)right)->im;
-
-    bool result = left_re == right_re && left_im == right_im;
-    
-    return new NBoolean(result);
+  // Both numbers, at least one complex
+  // A complex number with an imaginary part never equals a real number
+  if (isNumeric(left) && isNumeric(right)) {
+    bool result = realPart(left) == realPart(right) &&
+                  imaginaryPart(left) == imaginaryPart(right);
+    return Value::boolean(result);
   }
 
   throw RuntimeException("Invalid operands for '==' operator");
-  
+
   // Unreachable
-  return nullptr;
+  return Value();
 }
 
 /**
  * Same as nLogicalEqual
  */
-NObject *nLogicalNotEqual(NObject *left, NObject *right) {
-  NObject *temp_result;
+Value nLogicalNotEqual(Value left, Value right) {
+  Value temp_result;
   try {
     temp_result = nLogicalEqual(left, right);
   }
   catch (RuntimeException &e) {
     throw RuntimeException("Invalid operands for '!=' operator");
   }
-  bool areEqual = ((NBoolean *)temp_result)->value;
-  return new NBoolean(!areEqual);
+  bool areEqual = temp_result.asBoolean();
+  return Value::boolean(!areEqual);
 }
 
 /**
  * Implements napkin '>' operator
  * Only valid for real numbers
  */
-NObject *nGreater(NObject *left, NObject *right) {
-  NType left_type = left->getType();
-  NType right_type = right->getType();
+Value nGreater(Value left, Value right) {
+  if (areRealNumbers(left, right)) {
+    return Value::boolean(left.asNumber() > right.asNumber());
+  }
 
-  if (left_type == N_COMPLEX_NUMBER || right_type == N_COMPLEX_NUMBER) {
+  if (isComplexNumber(left) || isComplexNumber(right)) {
     throw RuntimeException("'>' operator does not support complex numbers.");
   }
-  if (left_type != N_REAL_NUMBER || right_type != N_REAL_NUMBER) {
-    throw RuntimeException("invalid operands for '>' operator.");
-  }
-
-  double left_value = ((NRealNumber *)left)->value;
-  double right_value = ((NRealNumber *)right)->value;
-
-  return new NBoolean(left_value > right_value);
+  throw RuntimeException("invalid operands for '>' operator.");
 }
 
 /**
  * Implements napkin '<' operator
  * Only valid for real numbers
  */
-NObject *nLess(NObject *left, NObject *right) {
-  NType left_type = left->getType();
-  NType right_type = right->getType();
+Value nLess(Value left, Value right) {
+  if (areRealNumbers(left, right)) {
+    return Value::boolean(left.asNumber() < right.asNumber());
+  }
 
-  if (left_type == N_COMPLEX_NUMBER || right_type == N_COMPLEX_NUMBER) {
+  if (isComplexNumber(left) || isComplexNumber(right)) {
     throw RuntimeException("'<' operator does not support complex numbers.");
   }
-  if (left_type != N_REAL_NUMBER || right_type != N_REAL_NUMBER) {
-    throw RuntimeException("invalid operands for '<' operator.");
-  }
-
-  double left_value = ((NRealNumber *)left)->value;
-  double right_value = ((NRealNumber *)right)->value;
-
-  return new NBoolean(left_value < right_value);
+  throw RuntimeException("invalid operands for '<' operator.");
 }
 
 /**
  * Implements napkin '>=' operator
  * Only valid for real numbers
  */
-NObject *nGreaterEqual(NObject *left, NObject *right) {
-  NType left_type = left->getType();
-  NType right_type = right->getType();
+Value nGreaterEqual(Value left, Value right) {
+  if (areRealNumbers(left, right)) {
+    return Value::boolean(left.asNumber() >= right.asNumber());
+  }
 
-  if (left_type == N_COMPLEX_NUMBER || right_type == N_COMPLEX_NUMBER) {
+  if (isComplexNumber(left) || isComplexNumber(right)) {
     throw RuntimeException("'>=' operator does not support complex numbers.");
   }
-  if (left_type != N_REAL_NUMBER || right_type != N_REAL_NUMBER) {
-    throw RuntimeException("invalid operands for '>=' operator.");
-  }
-
-  double left_value = ((NRealNumber *)left)->value;
-  double right_value = ((NRealNumber *)right)->value;
-
-  return new NBoolean(left_value >= right_value);
+  throw RuntimeException("invalid operands for '>=' operator.");
 }
 
 /**
  * Implements napkin '<=' operator
  * Only valid for real numbers
  */
-NObject *nLessEqual(NObject *left, NObject *right) {
-  NType left_type = left->getType();
-  NType right_type = right->getType();
+Value nLessEqual(Value left, Value right) {
+  if (areRealNumbers(left, right)) {
+    return Value::boolean(left.asNumber() <= right.asNumber());
+  }
 
-  if (left_type == N_COMPLEX_NUMBER || right_type == N_COMPLEX_NUMBER) {
+  if (isComplexNumber(left) || isComplexNumber(right)) {
     throw RuntimeException("'<=' operator does not support complex numbers.");
   }
-  if (left_type != N_REAL_NUMBER || right_type != N_REAL_NUMBER) {
-    throw RuntimeException("invalid operands for '<=' operator.");
-  }
-
-  double left_value = ((NRealNumber *)left)->value;
-  double right_value = ((NRealNumber *)right)->value;
-
-  return new NBoolean(left_value <= right_value);
+  throw RuntimeException("invalid operands for '<=' operator.");
 }
 
 /**
  * Returns true is left and right are real numbers.
  */
-bool areRealNumbers(NObject *left, NObject *right) {
-  return isRealNumber(left) && isRealNumber(right);
+bool areRealNumbers(Value left, Value right) {
+  return left.isNumber() && right.isNumber();
 }
 
 /**
  * Returns true is left and right are complex numbers.
  */
-bool areComplexNumbers(NObject *left, NObject *right) {
+bool areComplexNumbers(Value left, Value right) {
   return isComplexNumber(left) && isComplexNumber(right);
 }
 
 /**
- * Returns true if napkin object is a real number.
+ * Returns true if napkin value is a real number.
+ */
+bool isRealNumber(Value object) {
+  return object.isNumber();
+}
+
+/**
+ * Returns true if napkin value is a complex number.
  */
-bool isRealNumber(NObject *object) {
-  return object->getType() == N_REAL_NUMBER;
+bool isComplexNumber(Value object) {
+  return object.isObject() && object.asObject()->getType() == N_COMPLEX_NUMBER;
 }
 
 /**
- * Returns true if napkin object is a complex number.
+ * Returns true if napkin value is a real or complex number.
  */
-bool isComplexNumber(NObject *object) {
-  NType type = object->getType();
-  return type == N_COMPLEX_NUMBER;
+bool isNumeric(Value object) {
+  return object.isNumber() || isComplexNumber(object);
 }
 
 } // namespace napkin
@@ -5,39 +5,41 @@
 
 #include "nobject.h"
 #include "nexception.h"
+#include "value.h"
 
 /**
- * Defines napkin language operators on NObjects
+ * Defines napkin language operators on napkin values
  */
 
 namespace napkin {
 
 // Operators
-NObject *nAdd(NObject *left, NObject* right);
-NObject *nSubtract(NObject *left, NObject* right);
-NObject *nNegate(NObject *right);
-NObject *nMultiply(NObject *left, NObject *right);
-NObject *nJ(NObject *right);
-NObject *nDivide(NObject *left, NObject *right);
-NObject *nPower(NObject *left, NObject *right);
-NObject *nNot(NObject *right);
-NObject *nLogicalOr(NObject *left, NObject *right);
-NObject *nLogicalAnd(NObject *left, NObject *right);
-NObject *nLogicalEqual(NObject *left, NObject *right);
-NObject *nLogicalNotEqual(NObject *left, NObject *right);
-NObject *nGreater(NObject *left, NObject *right);
-NObject *nLess(NObject *left, NObject *right);
-NObject *nGreaterEqual(NObject *left, NObject *right);
-NObject *nLessEqual(NObject *left, NObject *right);
+Value nAdd(Value left, Value right);
+Value nSubtract(Value left, Value right);
+Value nNegate(Value right);
+Value nMultiply(Value left, Value right);
+Value nJ(Value right);
+Value nDivide(Value left, Value right);
+Value nPower(Value left, Value right);
+Value nNot(Value right);
+Value nLogicalOr(Value left, Value right);
+Value nLogicalAnd(Value left, Value right);
+Value nLogicalEqual(Value left, Value right);
+Value nLogicalNotEqual(Value left, Value right);
+Value nGreater(Value left, Value right);
+Value nLess(Value left, Value right);
+Value nGreaterEqual(Value left, Value right);
+Value nLessEqual(Value left, Value right);
 
 // Helpers
-bool isTruthy(NObject *object);
+bool isTruthy(Value object);
 
 // Type checking
-bool areRealNumbers(NObject *left, NObject *right);
-bool areComplexNumbers(NObject *left, NObject *right);
-bool isRealNumber(NObject *object);
-bool isComplexNumber(NObject *object);
+bool areRealNumbers(Value left, Value right);
+bool areComplexNumbers(Value left, Value right);
+bool isRealNumber(Value object);
+bool isComplexNumber(Value object);
+bool isNumeric(Value object);
 
 } // namespace napkin
 
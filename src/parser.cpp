@@ -25,7 +25,7 @@ Stmt *Parser::stmt() {
     return outputStmt();
   }
   if (match(TOKEN_LEFT_BRACE)) {
-    return new BlockStmt(blockStmt());
+    return blockStmt();
   }
   if (match(TOKEN_IF)) {
     return ifStmt();
@@ -46,7 +46,7 @@ Stmt *Parser::stmt() {
 Stmt *Parser::exprStmt() {
   Expr *value = expr();
   checkTerminator();
-  return new ExprStmt(value);
+  return arena->make<ExprStmt>(value);
 }
 
 /**
@@ -55,13 +55,13 @@ Stmt *Parser::exprStmt() {
 Stmt *Parser::outputStmt() {
   Expr *value = expr();
   checkTerminator();
-  return new OutputStmt(value);
+  return arena->make<OutputStmt>(value);
 }
 
 /**
  * Parses a block statment.
  */
-std::vector<Stmt *> Parser::blockStmt() {
+BlockStmt *Parser::blockStmt() {
   std::vector<Stmt *> stmts;
 
   // Continue gathering statements to be added to the block until we reach '}'
@@ -75,7 +75,7 @@ std::vector<Stmt *> Parser::blockStmt() {
     throw ParserException("expected '}' after block.");
   }
 
-  return stmts;
+  return arena->make<BlockStmt>(stmts);
 }
 
 /**
@@ -96,7 +96,7 @@ Stmt *Parser::ifStmt() {
     ignoreNewlines();
   }
 
-  return new IfStmt(condition, thenBranch, elseBranch);
+  return arena->make<IfStmt>(condition, thenBranch, elseBranch);
 }
 
 /**
@@ -108,7 +108,7 @@ Stmt *Parser::whileStmt() {
 
   Stmt *body = stmt();
 
-  return new WhileStmt(condition, body);
+  return arena->make<WhileStmt>(condition, body);
 }
 
 /**
@@ -125,7 +125,7 @@ Stmt *Parser::returnStmt() {
   ignoreNewlines();
   checkTerminator();
 
-  return new ReturnStmt(keyword, value);
+  return arena->make<ReturnStmt>(keyword, value);
 }
 
 /**
@@ -152,15 +152,16 @@ Expr *Parser::expr() {
  * Parses lambda expression
  */
 Expr *Parser::lambdaExpr() {
+  Token arrow = previous();
   std::vector<Identifier *> parameters;
   // Parse parameter list
   // note: list may be empty brackets
   if (match(TOKEN_LEFT_PAREN)) {
     if (check(TOKEN_IDENTIFIER)) {
-      parameters.push_back(new Identifier(advance()));
+      parameters.push_back(arena->make<Identifier>(advance()));
       while (match(TOKEN_COMMA)) {
         if (check(TOKEN_IDENTIFIER)) {
-          parameters.push_back(new Identifier(advance()));
+          parameters.push_back(arena->make<Identifier>(advance()));
         } else {
           throw napkin::ParserException(
               "expected identifier after comma in parameter list.");
@@ -176,8 +177,8 @@ Expr *Parser::lambdaExpr() {
   if (!match(TOKEN_LEFT_BRACE)) {
     throw napkin::ParserException("expected opening '{' for lambda body.");
   }
-  BlockStmt *body = new BlockStmt(blockStmt());
-  return new LambdaExpr(parameters, body);
+  BlockStmt *body = blockStmt();
+  return arena->make<LambdaExpr>(arrow, parameters, body, arena);
 }
 
 /**
@@ -193,10 +194,10 @@ Expr *Parser::assignExpr() {
     advance();
     if (nextNext == TOKEN_EQUAL) {
       Expr *value = expr();
-      return new AssignExpr(name, value);
+      return arena->make<AssignExpr>(name, value);
     } else if (nextNext == TOKEN_COLON_EQUAL) {
       Expr *value = expr();
-      return new VarDeclExpr(name, value);
+      return arena->make<VarDeclExpr>(name, value);
     } else {
       throw napkin::ImplementationException("unhandled assignment operator");
     }
@@ -215,7 +216,7 @@ Expr *Parser::_or() {
     Token _operator = previous();
     Expr *right = _and();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -231,7 +232,7 @@ Expr *Parser::_and() {
     Token _operator = previous();
     Expr *right = equality();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -247,7 +248,7 @@ Expr *Parser::equality() {
     Token _operator = previous();
     Expr *right = comparison();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
   
   return expr;
@@ -264,7 +265,7 @@ Expr *Parser::comparison() {
     Token _operator = previous();
     Expr *right = addition();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -280,7 +281,7 @@ Expr *Parser::addition() {
     Token _operator = previous();
     Expr *right = multiplication();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -296,7 +297,7 @@ Expr *Parser::multiplication() {
     Token _operator = previous();
     Expr *right = exponentiation();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -312,7 +313,7 @@ Expr *Parser::exponentiation() {
     Token _operator = previous();
     Expr *right = exponentiation();
     // Attach the old expr to the left and the new one to the right
-    expr = new BinaryExpr(_operator, expr, right);
+    expr = arena->make<BinaryExpr>(_operator, expr, right);
   }
 
   return expr;
@@ -325,7 +326,7 @@ Expr *Parser::unary() {
   if (match(TOKEN_MINUS) || match(TOKEN_BANG) || match(TOKEN_NOT)) {
     Token _operator = previous();
     Expr *right = unary();
-    Expr *expr = new UnaryExpr(_operator, right);
+    Expr *expr = arena->make<UnaryExpr>(_operator, right);
     return expr;
   }
 
@@ -364,7 +365,7 @@ Expr *Parser::finishCall(Expr *callee) {
 
   if (check(TOKEN_RIGHT_PAREN)) {
     Token paren = advance();
-    return new CallExpr(callee, paren, arguments);
+    return arena->make<CallExpr>(callee, paren, arguments);
   } else {
     throw RuntimeException("expected ')' after arguments in function call.");
   }
@@ -376,13 +377,13 @@ Expr *Parser::finishCall(Expr *callee) {
 Expr* Parser::primary() {
   // Boolean literals
   if (match(TOKEN_TRUE) || match(TOKEN_FALSE)) {
-    return new Boolean(previous());
+    return arena->make<Boolean>(previous());
   }
 
   // Keywords that are constants
   // e.g. "pi", "euler", etc.
   if (match(TOKEN_PI) || match(TOKEN_EULER)) {
-    return new KeywordConstant(previous());
+    return arena->make<KeywordConstant>(previous());
   }
 
   // Keywords that act an unary operators
@@ -392,21 +393,21 @@ Expr* Parser::primary() {
     Token _operator = previous();
     // TODO: should this be unary or primary?
     Expr *right = unary();
-    return new UnaryExpr(_operator, right);
+    return arena->make<UnaryExpr>(_operator, right);
   }
 
   // Real number literals
   if (match(TOKEN_NUMBER_LITERAL)) {
-    return new RealNumber(previous());
+    return arena->make<RealNumber>(previous());
   }
   // Imaginary number literals
   if (match(TOKEN_IM_NUMBER_LITERAL)) {
-    return new ImaginaryNumber(previous());
+    return arena->make<ImaginaryNumber>(previous());
   }
 
   // String literals
   if (match(TOKEN_STRING_LITERAL)) {
-    return new String(previous());
+    return arena->make<String>(previous());
   }
 
   // Parenthesized groupings
@@ -421,12 +422,12 @@ Expr* Parser::primary() {
       throw ParserException("expected ')' after expression.");
     }
 
-    return new Grouping(_expr);
+    return arena->make<Grouping>(_expr);
   }
 
   // Identifiers
   if (match(TOKEN_IDENTIFIER)) {
-    return new Identifier(previous());
+    return arena->make<Identifier>(previous());
   }
 
   throw ImplementationException("unhandled TokenType: " +
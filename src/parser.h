@@ -5,6 +5,7 @@
 #include <iostream>
 
 #include "AST.h"
+#include "arena.h"
 #include "nexception.h"
 #include "token.h"
 
@@ -12,10 +13,13 @@ namespace napkin {
 
 /**
  * Recursive descent parser
+ * Every node of the AST is allocated in the arena passed to the constructor,
+ * which owns the tree from then on.
  */
 class Parser {
 public:
-  Parser(std::vector<Token> t_tokens) : tokens(t_tokens) {
+  Parser(std::vector<Token> t_tokens, Arena *t_arena)
+      : tokens(t_tokens), arena(t_arena) {
     hadError = false;
   };
   std::vector<Stmt *> parse();
@@ -23,13 +27,14 @@ public:
 
 private:
   std::vector<Token> tokens;
+  Arena *arena;
   unsigned int current = 0; // index of current token
 
   // Each of these methods correspond to a rule in ebnf.txt
   Stmt *stmt();
   Stmt *exprStmt();
   Stmt *outputStmt();
-  std::vector<Stmt *> blockStmt();
+  BlockStmt *blockStmt();
   Stmt *ifStmt();
   Stmt *whileStmt();
   Stmt *returnStmt();
@@ -0,0 +1,82 @@
+#include "pool.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace napkin {
+
+// Number of blocks requested from the system allocator at a time
+static const std::size_t BLOCKS_PER_SLAB = 64;
+
+Pool::Pool(std::size_t t_blockSize) : blockSize(t_blockSize) {
+  freeList = nullptr;
+  slabCurrent = nullptr;
+  slabEnd = nullptr;
+  allocations = 0;
+  reuses = 0;
+}
+
+Pool::~Pool() {
+  for (unsigned long i = 0; i < slabs.size(); i++) {
+    std::free(slabs[i]);
+  }
+}
+
+/**
+ * Returns a block, preferring recently freed ones.
+ */
+void *Pool::allocate() {
+  allocations++;
+  if (freeList != nullptr) {
+    FreeBlock *block = freeList;
+    freeList = block->next;
+    reuses++;
+    return block;
+  }
+  if (slabCurrent == slabEnd) {
+    refill();
+  }
+  void *block = slabCurrent;
+  slabCurrent += blockSize;
+  return block;
+}
+
+/**
+ * Puts a block back on the free list. The memory is kept for reuse.
+ */
+void Pool::deallocate(void *block) {
+  FreeBlock *freeBlock = (FreeBlock *)block;
+  freeBlock->next = freeList;
+  freeList = freeBlock;
+}
+
+std::size_t Pool::getBlockSize() {
+  return blockSize;
+}
+
+std::size_t Pool::getAllocations() {
+  return allocations;
+}
+
+std::size_t Pool::getReuses() {
+  return reuses;
+}
+
+std::size_t Pool::getSlabCount() {
+  return slabs.size();
+}
+
+/**
+ * Requests a new slab from the system allocator.
+ */
+void Pool::refill() {
+  char *slab = (char *)std::malloc(blockSize * BLOCKS_PER_SLAB);
+  if (slab == nullptr) {
+    throw std::bad_alloc();
+  }
+  slabs.push_back(slab);
+  slabCurrent = slab;
+  slabEnd = slab + blockSize * BLOCKS_PER_SLAB;
+}
+
+} // namespace napkin
@@ -0,0 +1,54 @@
+#ifndef NAPKIN_POOL_H_
+#define NAPKIN_POOL_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace napkin {
+
+/**
+ * Free-list allocator for blocks of one fixed size.
+ * Memory is taken from the system allocator a slab at a time and recycled
+ * through the free list afterwards, so short-lived objects of the same size
+ * class never reach malloc/free.
+ */
+class Pool {
+public:
+  Pool(std::size_t t_blockSize);
+  ~Pool();
+
+  void *allocate();
+  void deallocate(void *block);
+
+  std::size_t getBlockSize();
+  // Number of blocks handed out
+  std::size_t getAllocations();
+  // Number of those blocks that were recycled from the free list
+  std::size_t getReuses();
+  // Number of slabs requested from the system allocator
+  std::size_t getSlabCount();
+
+private:
+  /**
+   * Free blocks are linked through their first word.
+   */
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  void refill();
+
+  std::size_t blockSize;
+  FreeBlock *freeList;
+  std::vector<void *> slabs;
+  // Unused part of the newest slab
+  char *slabCurrent;
+  char *slabEnd;
+
+  std::size_t allocations;
+  std::size_t reuses;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,117 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace napkin {
+
+HeapProfiler::HeapProfiler(std::string t_fileName) : fileName(t_fileName) {
+  Site unknown;
+  unknown.line = 0;
+  unknown.column = 0;
+  sites.push_back(unknown);
+  dumpInterval = std::chrono::milliseconds(0);
+}
+
+unsigned int HeapProfiler::getSite(Token &token) {
+  uint64_t key = ((uint64_t)token.getLine() << 32) | token.getColumn();
+  auto it = siteIds.find(key);
+  if (it != siteIds.end()) {
+    return it->second;
+  }
+  Site site;
+  site.line = token.getLine();
+  site.column = token.getColumn();
+  site.lexeme = token.getLexeme();
+  sites.push_back(site);
+  siteIds[key] = sites.size() - 1;
+  return sites.size() - 1;
+}
+
+void HeapProfiler::recordAllocation(unsigned int site, std::size_t bytes) {
+  sites[site].stats.objects++;
+  sites[site].stats.bytes += bytes;
+}
+
+void HeapProfiler::recordDeath(const char *type, std::size_t bytes) {
+  Stats &stats = deadTypes[type];
+  stats.objects++;
+  stats.bytes += bytes;
+}
+
+void HeapProfiler::recordLive(const char *type, std::size_t bytes) {
+  Stats &stats = liveTypes[type];
+  stats.objects++;
+  stats.bytes += bytes;
+}
+
+void HeapProfiler::setDumpInterval(unsigned long milliseconds) {
+  dumpInterval = std::chrono::milliseconds(milliseconds);
+  nextDump = std::chrono::steady_clock::now() + dumpInterval;
+}
+
+void HeapProfiler::poll() {
+  if (dumpInterval.count() == 0) {
+    return;
+  }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now >= nextDump) {
+    print(std::cerr);
+    nextDump = now + dumpInterval;
+  }
+}
+
+/**
+ * Prints how many objects and bytes were allocated per type and per site
+ * since the start of the run, largest first.
+ */
+void HeapProfiler::print(std::ostream &out) {
+  heap()->profileLiveObjects();
+
+  // Types of dead and live objects
+  std::unordered_map<std::string, Stats> types = deadTypes;
+  for (auto it = liveTypes.begin(); it != liveTypes.end(); ++it) {
+    types[it->first].objects += it->second.objects;
+    types[it->first].bytes += it->second.bytes;
+  }
+  liveTypes.clear();
+  std::vector<std::pair<std::string, Stats>> typeRows(types.begin(),
+                                                      types.end());
+  std::sort(typeRows.begin(), typeRows.end(),
+            [](const std::pair<std::string, Stats> &a,
+               const std::pair<std::string, Stats> &b) {
+              return a.second.bytes > b.second.bytes;
+            });
+
+  std::vector<Site> siteRows;
+  for (unsigned long i = 0; i < sites.size(); i++) {
+    if (sites[i].stats.objects != 0) {
+      siteRows.push_back(sites[i]);
+    }
+  }
+  std::sort(siteRows.begin(), siteRows.end(),
+            [](const Site &a, const Site &b) {
+              return a.stats.bytes > b.stats.bytes;
+            });
+
+  out << "heap profile: " << fileName << std::endl;
+  out << "     objects       bytes  type" << std::endl;
+  for (unsigned long i = 0; i < typeRows.size(); i++) {
+    out << std::setw(12) << typeRows[i].second.objects << std::setw(12)
+        << typeRows[i].second.bytes << "  " << typeRows[i].first << std::endl;
+  }
+  out << "     objects       bytes  site" << std::endl;
+  for (unsigned long i = 0; i < siteRows.size(); i++) {
+    out << std::setw(12) << siteRows[i].stats.objects << std::setw(12)
+        << siteRows[i].stats.bytes << "  ";
+    if (siteRows[i].line == 0) {
+      out << "(outside of any expression)" << std::endl;
+    } else {
+      out << fileName << ":" << siteRows[i].line << ":" << siteRows[i].column
+          << " '" << siteRows[i].lexeme << "'" << std::endl;
+    }
+  }
+}
+
+} // namespace napkin
@@ -0,0 +1,103 @@
+#ifndef NAPKIN_PROFILER_H_
+#define NAPKIN_PROFILER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "heap.h"
+#include "token.h"
+
+namespace napkin {
+
+/**
+ * Records where heap objects are allocated and what they are.
+ * Every allocation is counted against the AST node (identified by its token)
+ * that was being evaluated when it happened. The type of an object is only
+ * known once it is constructed, so types are counted when objects die and,
+ * for the survivors, when a profile is printed.
+ */
+class HeapProfiler {
+public:
+  HeapProfiler(std::string t_fileName);
+
+  // Returns the id of the allocation site for a token, creating it if needed
+  unsigned int getSite(Token &token);
+
+  // Used by the heap
+  void recordAllocation(unsigned int site, std::size_t bytes);
+  void recordDeath(const char *type, std::size_t bytes);
+  void recordLive(const char *type, std::size_t bytes);
+
+  // Prints the profile every interval milliseconds (0 disables the dumps)
+  void setDumpInterval(unsigned long milliseconds);
+  // Called at safe points to print periodic dumps
+  void poll();
+
+  // Prints tables of types and sites, ranked by bytes allocated
+  void print(std::ostream &out);
+
+private:
+  /**
+   * Number of objects and bytes counted against a type or site.
+   */
+  struct Stats {
+    std::size_t objects = 0;
+    std::size_t bytes = 0;
+  };
+
+  /**
+   * A place in the source where objects are allocated.
+   */
+  struct Site {
+    unsigned int line;
+    unsigned int column;
+    std::string lexeme;
+    Stats stats;
+  };
+
+  std::string fileName;
+
+  // Site 0 collects allocations made outside of any site (e.g. at parse time)
+  std::vector<Site> sites;
+  // Site ids by line and column
+  std::unordered_map<uint64_t, unsigned int> siteIds;
+
+  std::unordered_map<std::string, Stats> deadTypes;
+  std::unordered_map<std::string, Stats> liveTypes;
+
+  std::chrono::milliseconds dumpInterval;
+  std::chrono::steady_clock::time_point nextDump;
+};
+
+/**
+ * Attributes the allocations made during its lifetime to the site of a token.
+ * Does nothing unless the heap is being profiled.
+ */
+class AllocationSite {
+public:
+  AllocationSite(Token &token) : previous(0) {
+    HeapProfiler *profiler = heap()->getProfiler();
+    active = profiler != nullptr;
+    if (active) {
+      previous = heap()->setAllocationSite(profiler->getSite(token));
+    }
+  }
+  ~AllocationSite() {
+    if (active) {
+      heap()->setAllocationSite(previous);
+    }
+  }
+
+private:
+  bool active;
+  unsigned int previous;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,177 @@
+#include "purity.h"
+
+namespace napkin {
+
+PurityAnalyzer::PurityAnalyzer(bool t_incremental) {
+  incremental = t_incremental;
+  marking = false;
+}
+
+/**
+ * Finds the pure lambdas of the whole program first, since an assignment may
+ * come before the lambda reading the variable.
+ */
+void PurityAnalyzer::analyze(std::vector<Stmt *> &stmts) {
+  walk(false, stmts);
+  walk(true, stmts);
+}
+
+void PurityAnalyzer::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void PurityAnalyzer::visitExprStmt(ExprStmt *stmt) {
+  stmt->expr->accept(this);
+}
+
+void PurityAnalyzer::visitOutputStmt(OutputStmt *stmt) {
+  makeImpure();
+  stmt->expr->accept(this);
+}
+
+void PurityAnalyzer::visitBlockStmt(BlockStmt *stmt) {
+  for (unsigned long i = 0; i < stmt->stmts.size(); i++) {
+    stmt->stmts[i]->accept(this);
+  }
+}
+
+void PurityAnalyzer::visitIfStmt(IfStmt *stmt) {
+  stmt->condition->accept(this);
+  stmt->thenBranch->accept(this);
+  if (stmt->elseBranch != nullptr) {
+    stmt->elseBranch->accept(this);
+  }
+}
+
+void PurityAnalyzer::visitWhileStmt(WhileStmt *stmt) {
+  stmt->condition->accept(this);
+  stmt->body->accept(this);
+}
+
+void PurityAnalyzer::visitReturnStmt(ReturnStmt *stmt) {
+  if (stmt->value != nullptr) {
+    stmt->value->accept(this);
+  }
+}
+
+void PurityAnalyzer::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+/**
+ * Memoizing a lambda that creates closures would return the same closure
+ * from different calls, so those aren't pure.
+ */
+void PurityAnalyzer::visitLambdaExpr(LambdaExpr *expr) {
+  makeImpure();
+  Function function;
+  function.lambda = expr;
+  function.pure = true;
+  functions.push_back(function);
+  expr->body->accept(this);
+
+  Function &visited = functions.back();
+  if (!marking) {
+    expr->pure = visited.pure;
+    if (visited.pure) {
+      boxedReads.insert(visited.boxedReads.begin(), visited.boxedReads.end());
+      globalReads.insert(visited.globalReads.begin(),
+                         visited.globalReads.end());
+    }
+  }
+  functions.pop_back();
+}
+
+void PurityAnalyzer::visitVarDeclExpr(VarDeclExpr *expr) {
+  expr->value->accept(this);
+  if (assign(expr->slot, expr->boxed, true, expr->name.getLexeme())) {
+    expr->invalidatesMemos = true;
+  }
+}
+
+void PurityAnalyzer::visitAssignExpr(AssignExpr *expr) {
+  expr->value->accept(this);
+  if (assign(expr->slot, expr->boxed, false, expr->name.getLexeme())) {
+    expr->invalidatesMemos = true;
+  }
+}
+
+void PurityAnalyzer::visitBinaryExpr(BinaryExpr *expr) {
+  expr->left->accept(this);
+  expr->right->accept(this);
+}
+
+void PurityAnalyzer::visitGrouping(Grouping *expr) {
+  expr->contents->accept(this);
+}
+
+void PurityAnalyzer::visitUnaryExpr(UnaryExpr *expr) {
+  expr->right->accept(this);
+}
+
+void PurityAnalyzer::visitCallExpr(CallExpr *expr) {
+  expr->callee->accept(this);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    expr->arguments[i]->accept(this);
+  }
+}
+
+void PurityAnalyzer::visitIdentifier(Identifier *expr) {
+  if (marking || functions.empty()) {
+    return;
+  }
+  Function &function = functions.back();
+  if (expr->slot < 0) {
+    function.globalReads.push_back(expr->token.getLexeme());
+  } else if (expr->boxed) {
+    function.boxedReads.push_back(expr->token.getLexeme());
+  }
+}
+
+void PurityAnalyzer::visitRealNumber(RealNumber *expr) {}
+
+void PurityAnalyzer::visitImaginaryNumber(ImaginaryNumber *expr) {}
+
+void PurityAnalyzer::visitString(String *expr) {}
+
+void PurityAnalyzer::visitBoolean(Boolean *expr) {}
+
+void PurityAnalyzer::visitKeywordConstant(KeywordConstant *expr) {}
+
+void PurityAnalyzer::walk(bool t_marking, std::vector<Stmt *> &stmts) {
+  marking = t_marking;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    stmts[i]->accept(this);
+  }
+}
+
+/**
+ * Cells in the body of a pure lambda can only be captured variables, since
+ * lambdas that create closures aren't pure.
+ */
+bool PurityAnalyzer::assign(long slot, bool boxed, bool declares,
+                            const std::string &name) {
+  if (slot < 0) {
+    if (marking) {
+      return incremental || globalReads.count(name) != 0;
+    }
+    makeImpure();
+    return false;
+  }
+  if (!boxed || declares) {
+    return false;
+  }
+  if (marking) {
+    return boxedReads.count(name) != 0;
+  }
+  makeImpure();
+  return false;
+}
+
+void PurityAnalyzer::makeImpure() {
+  if (!marking && !functions.empty()) {
+    functions.back().pure = false;
+  }
+}
+
+} // namespace napkin
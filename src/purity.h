@@ -0,0 +1,98 @@
+#ifndef NAPKIN_PURITY_H_
+#define NAPKIN_PURITY_H_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace napkin {
+
+/**
+ * Finds the lambdas whose calls can be memoized (see LambdaExpr::pure and
+ * MemoCache), and the assignments that invalidate memoized results. Runs after
+ * the Resolver.
+ *
+ * A lambda is pure if its body has no output statement, creates no lambdas
+ * and assigns neither globals nor the variables it captures. Whether
+ * the functions it calls are pure is only known when they are called: a call
+ * that reaches a native function (getline, millis, ...) or an impure closure
+ * isn't memoized, and its lambda stops being pure (see NClosure::call).
+ *
+ * A pure lambda may still read captured variables and globals. Assigning one
+ * of them, or declaring a global, sets the node's invalidatesMemos flag.
+ * Both are told apart by name only, which may invalidate more than needed.
+ * Declaring a captured variable doesn't invalidate anything: its cell was
+ * undefined until then, so every call reading it failed.
+ *
+ * When the program is analyzed incrementally (a line at a time in the REPL),
+ * a later part may add a pure lambda reading a global that earlier parts
+ * assign. Their nodes were already marked, so every assignment or declaration
+ * of a global invalidates memoized results instead. Captured variables stay
+ * exact, since only lambdas of the same part can read them.
+ */
+class PurityAnalyzer : public ASTVisitor<void> {
+public:
+  // An incremental analyzer is called on one part of the program at a time
+  PurityAnalyzer(bool t_incremental);
+
+  void analyze(std::vector<Stmt *> &stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  /**
+   * A lambda whose body is being visited.
+   */
+  struct Function {
+    LambdaExpr *lambda;
+    bool pure;
+    // Names of the captured variables and globals the body reads
+    std::vector<std::string> boxedReads;
+    std::vector<std::string> globalReads;
+  };
+
+  void walk(bool t_marking, std::vector<Stmt *> &stmts);
+
+  // Records an assignment or declaration, returns true if it invalidates
+  // memoized results
+  bool assign(long slot, bool boxed, bool declares, const std::string &name);
+  void makeImpure();
+
+  bool incremental;
+  // False while finding the pure lambdas, true while marking assignments
+  bool marking;
+
+  // Lambdas enclosing the node being visited (the innermost one is last)
+  std::vector<Function> functions;
+
+  // Names of the variables that pure lambdas read
+  std::set<std::string> boxedReads;
+  std::set<std::string> globalReads;
+};
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,98 @@
+#include "region.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "heap.h"
+
+namespace napkin {
+
+// Size of each block the region allocates from
+static const std::size_t BLOCK_SIZE = 16 * 1024;
+// Every allocation is rounded up to a multiple of this
+static const std::size_t ALIGNMENT = 16;
+
+Region::Region(std::size_t t_limit) {
+  limit = t_limit;
+  currentBlock = 0;
+  offset = 0;
+  allocations = 0;
+  peakBytes = 0;
+}
+
+Region::~Region() {
+  release(Mark{0, 0, 0});
+  for (unsigned long i = 0; i < blocks.size(); i++) {
+    std::free(blocks[i]);
+  }
+}
+
+/**
+ * Bump allocates from the current block, moving on to the next block if it
+ * is full.
+ */
+void *Region::allocate(std::size_t size) {
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (size > BLOCK_SIZE) {
+    return nullptr;
+  }
+  if (offset + size > BLOCK_SIZE) {
+    if ((currentBlock + 2) * BLOCK_SIZE > limit) {
+      return nullptr;
+    }
+    currentBlock++;
+    offset = 0;
+  }
+  if (currentBlock == blocks.size()) {
+    char *block = (char *)std::malloc(BLOCK_SIZE);
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    blocks.push_back(block);
+  }
+
+  void *memory = blocks[currentBlock] + offset;
+  offset += size;
+  allocations++;
+  std::size_t bytes = currentBlock * BLOCK_SIZE + offset;
+  if (bytes > peakBytes) {
+    peakBytes = bytes;
+  }
+  return memory;
+}
+
+void Region::addObject(HeapObject *object) {
+  objects.push_back(object);
+}
+
+Region::Mark Region::getMark() {
+  return Mark{currentBlock, offset, objects.size()};
+}
+
+/**
+ * Destroys every object allocated since the mark was taken, newest first, and
+ * makes their memory available again.
+ */
+void Region::release(Mark mark) {
+  while (objects.size() > mark.objects) {
+    // The memory belongs to the region, so only the destructor runs
+    objects.back()->~HeapObject();
+    objects.pop_back();
+  }
+  currentBlock = mark.block;
+  offset = mark.offset;
+}
+
+std::vector<HeapObject *> &Region::getObjects() {
+  return objects;
+}
+
+std::size_t Region::getAllocations() {
+  return allocations;
+}
+
+std::size_t Region::getPeakBytes() {
+  return peakBytes;
+}
+
+} // namespace napkin
@@ -0,0 +1,66 @@
+#ifndef NAPKIN_REGION_H_
+#define NAPKIN_REGION_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace napkin {
+
+class HeapObject;
+
+/**
+ * Stack-like bump allocator for heap objects that are known to die before the
+ * closure call that created them returns.
+ * A call takes a mark when it starts and releases back to it when it returns,
+ * destroying everything allocated in between at once. The region never grows
+ * past its limit; allocations that don't fit go to the garbage collected heap
+ * instead.
+ */
+class Region {
+public:
+  /**
+   * Position in the region to release back to.
+   */
+  struct Mark {
+    unsigned long block;
+    std::size_t offset;
+    unsigned long objects;
+  };
+
+  Region(std::size_t t_limit);
+  ~Region();
+
+  // Returns nullptr if the region is full
+  void *allocate(std::size_t size);
+  // Registers an object whose destructor runs when it is released
+  void addObject(HeapObject *object);
+
+  Mark getMark();
+  void release(Mark mark);
+
+  // Objects currently alive in the region
+  std::vector<HeapObject *> &getObjects();
+
+  // Number of objects ever allocated in the region
+  std::size_t getAllocations();
+  // Largest number of bytes the region has held at once
+  std::size_t getPeakBytes();
+
+private:
+  std::size_t limit;
+
+  // Blocks are kept after a release so they can be reused
+  std::vector<char *> blocks;
+  unsigned long currentBlock;
+  // Bytes used in the current block
+  std::size_t offset;
+
+  std::vector<HeapObject *> objects;
+
+  std::size_t allocations;
+  std::size_t peakBytes;
+};
+
+} // namespace napkin
+
+#endif
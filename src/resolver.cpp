@@ -0,0 +1,305 @@
+#include "resolver.h"
+
+namespace napkin {
+
+Resolver::Resolver(std::vector<std::string> globalNames) {
+  for (unsigned long i = 0; i < globalNames.size(); i++) {
+    globals.insert(globalNames[i]);
+  }
+  current = nullptr;
+  tail = false;
+  inFunction = false;
+}
+
+/**
+ * Resolves a list of top level statements.
+ */
+void Resolver::resolve(std::vector<Stmt *> stmts) {
+  current = nullptr;
+  tail = false;
+  inFunction = false;
+  visitStmts(stmts);
+
+  // Every scope now knows whether it gets a frame, so depths can be counted,
+  // and which of its variables are captured
+  for (unsigned long i = 0; i < references.size(); i++) {
+    Reference &reference = references[i];
+    *reference.depth = countFrames(reference.from, reference.to);
+    *reference.boxed =
+        reference.to != nullptr && reference.to->boxed[reference.slot];
+  }
+  for (unsigned long i = 0; i < captureReferences.size(); i++) {
+    CaptureReference &reference = captureReferences[i];
+    reference.lambda->captures[reference.capture].depth =
+        countFrames(reference.from, reference.to);
+  }
+  for (unsigned long i = 0; i < blocks.size(); i++) {
+    blocks[i].first->needsFrame = blocks[i].second->hasFrame();
+    blocks[i].first->slotCount = blocks[i].second->boxed.size();
+  }
+
+  references.clear();
+  captureReferences.clear();
+  blocks.clear();
+  scopes.clear();
+}
+
+/**
+ * Only the last statement of a list can be in tail position.
+ */
+void Resolver::visitStmts(std::vector<Stmt *> &stmts) {
+  bool listTail = tail;
+  for (unsigned long i = 0; i < stmts.size(); i++) {
+    tail = listTail && i == stmts.size() - 1;
+    visitStmt(stmts[i]);
+  }
+  tail = listTail;
+}
+
+void Resolver::visitStmt(Stmt *stmt) {
+  stmt->accept(this);
+}
+
+void Resolver::visitExprStmt(ExprStmt *stmt) {
+  stmt->expr->accept(this);
+}
+
+void Resolver::visitOutputStmt(OutputStmt *stmt) {
+  tail = false;
+  stmt->expr->accept(this);
+}
+
+void Resolver::visitBlockStmt(BlockStmt *stmt) {
+  Scope *scope = pushScope(nullptr);
+  visitStmts(stmt->stmts);
+  blocks.push_back(std::make_pair(stmt, scope));
+  popScope();
+}
+
+void Resolver::visitIfStmt(IfStmt *stmt) {
+  // The value of an if statement is the value of its branch
+  bool branchTail = tail;
+  tail = false;
+  stmt->condition->accept(this);
+  tail = branchTail;
+  visitStmt(stmt->thenBranch);
+  tail = branchTail;
+  if (stmt->elseBranch != nullptr) {
+    visitStmt(stmt->elseBranch);
+  }
+}
+
+void Resolver::visitWhileStmt(WhileStmt *stmt) {
+  tail = false;
+  stmt->condition->accept(this);
+  visitStmt(stmt->body);
+}
+
+void Resolver::visitReturnStmt(ReturnStmt *stmt) {
+  tail = inFunction;
+  if (stmt->value != nullptr) {
+    stmt->value->accept(this);
+  }
+}
+
+void Resolver::visitExpr(Expr *expr) {
+  expr->accept(this);
+}
+
+/**
+ * The parameters, the top level of the body and the captures share the call
+ * frame.
+ */
+void Resolver::visitLambdaExpr(LambdaExpr *expr) {
+  Scope *scope = pushScope(expr);
+  for (unsigned long i = 0; i < expr->parameters.size(); i++) {
+    Identifier *parameter = expr->parameters[i];
+    declare(parameter->token.getLexeme(), &parameter->depth,
+            &parameter->slot, &parameter->boxed);
+  }
+  bool enclosingInFunction = inFunction;
+  inFunction = true;
+  tail = true;
+  visitStmts(expr->body->stmts);
+  inFunction = enclosingInFunction;
+  tail = false;
+  blocks.push_back(std::make_pair(expr->body, scope));
+  popScope();
+}
+
+void Resolver::visitVarDeclExpr(VarDeclExpr *expr) {
+  // The value is resolved first: in "c := c + 1" the right hand side refers
+  // to an outer c
+  tail = false;
+  expr->value->accept(this);
+  declare(expr->name.getLexeme(), &expr->depth, &expr->slot, &expr->boxed);
+}
+
+void Resolver::visitAssignExpr(AssignExpr *expr) {
+  tail = false;
+  expr->value->accept(this);
+  std::string name = expr->name.getLexeme();
+  if (findLocal(name) != nullptr || current == nullptr ||
+      globals.count(name) != 0) {
+    address(name, &expr->depth, &expr->slot, &expr->boxed);
+    if (current == nullptr) {
+      globals.insert(name);
+    }
+  } else {
+    // '=' creates a local when the name isn't bound anywhere
+    declare(name, &expr->depth, &expr->slot, &expr->boxed);
+  }
+}
+
+void Resolver::visitBinaryExpr(BinaryExpr *expr) {
+  tail = false;
+  expr->left->accept(this);
+  expr->right->accept(this);
+}
+
+void Resolver::visitGrouping(Grouping *expr) {
+  expr->contents->accept(this);
+}
+
+void Resolver::visitUnaryExpr(UnaryExpr *expr) {
+  tail = false;
+  expr->right->accept(this);
+}
+
+void Resolver::visitCallExpr(CallExpr *expr) {
+  expr->tail = tail;
+  tail = false;
+  expr->callee->accept(this);
+  for (unsigned long i = 0; i < expr->arguments.size(); i++) {
+    expr->arguments[i]->accept(this);
+  }
+}
+
+void Resolver::visitIdentifier(Identifier *expr) {
+  address(expr->token.getLexeme(), &expr->depth, &expr->slot, &expr->boxed);
+}
+
+void Resolver::visitRealNumber(RealNumber *expr) {}
+
+void Resolver::visitImaginaryNumber(ImaginaryNumber *expr) {}
+
+void Resolver::visitString(String *expr) {}
+
+void Resolver::visitBoolean(Boolean *expr) {}
+
+void Resolver::visitKeywordConstant(KeywordConstant *expr) {}
+
+unsigned long Resolver::Scope::newSlot() {
+  boxed.push_back(false);
+  return boxed.size() - 1;
+}
+
+Resolver::Scope *Resolver::pushScope(LambdaExpr *lambda) {
+  scopes.push_back(std::unique_ptr<Scope>(new Scope));
+  Scope *scope = scopes.back().get();
+  scope->parent = current;
+  scope->lambda = lambda;
+  current = scope;
+  return scope;
+}
+
+// Scopes are kept until the end of resolve() since references point to them
+void Resolver::popScope() {
+  current = current->parent;
+}
+
+Resolver::Scope *Resolver::findLocal(std::string name) {
+  for (Scope *scope = current; scope != nullptr; scope = scope->parent) {
+    if (scope->slots.count(name) != 0) {
+      return scope;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * A name declared outside of a function body is captured by the lambda, and
+ * so by every lambda between it and the declaration.
+ */
+Resolver::Scope *Resolver::lookup(Scope *from, const std::string &name,
+                                  unsigned long &slot) {
+  for (Scope *scope = from; scope != nullptr; scope = scope->parent) {
+    auto it = scope->slots.find(name);
+    if (it != scope->slots.end()) {
+      slot = it->second;
+      return scope;
+    }
+    if (scope->lambda == nullptr) {
+      continue;
+    }
+    it = scope->captures.find(name);
+    if (it != scope->captures.end()) {
+      slot = it->second;
+      return scope;
+    }
+
+    unsigned long outerSlot;
+    Scope *outer = lookup(scope->parent, name, outerSlot);
+    if (outer == nullptr) {
+      return nullptr;
+    }
+    outer->boxed[outerSlot] = true;
+    slot = scope->newSlot();
+    scope->boxed[slot] = true;
+    scope->captures[name] = slot;
+    scope->lambda->captures.push_back(Capture(outerSlot, slot));
+    captureReferences.push_back(CaptureReference{
+        scope->lambda, scope->lambda->captures.size() - 1, scope->parent,
+        outer});
+    return scope;
+  }
+  return nullptr;
+}
+
+/**
+ * Annotates a use of a name with the variable it refers to.
+ */
+void Resolver::address(std::string name, unsigned long *depth, long *slot,
+                       bool *boxed) {
+  unsigned long found = 0;
+  Scope *scope = lookup(current, name, found);
+  *slot = scope != nullptr ? (long)found : -1;
+  references.push_back(Reference{depth, boxed, current, scope, found});
+}
+
+/**
+ * Declares a name in the current scope. Declaring a name twice in the same
+ * scope reuses its slot, so the interpreter reports the re-declaration when
+ * it happens.
+ */
+void Resolver::declare(std::string name, unsigned long *depth, long *slot,
+                       bool *boxed) {
+  if (current == nullptr) {
+    globals.insert(name);
+    *depth = 0;
+    *slot = -1;
+    *boxed = false;
+    return;
+  }
+  auto it = current->slots.find(name);
+  if (it == current->slots.end()) {
+    it = current->slots.insert(std::make_pair(name, current->newSlot())).first;
+  }
+  *slot = it->second;
+  references.push_back(Reference{depth, boxed, current, current, it->second});
+}
+
+/**
+ * Counts the frames between a scope and an enclosing one.
+ */
+unsigned long Resolver::countFrames(Scope *from, Scope *to) {
+  unsigned long depth = 0;
+  for (Scope *scope = from; scope != to; scope = scope->parent) {
+    if (scope->hasFrame()) {
+      depth++;
+    }
+  }
+  return depth;
+}
+
+} // namespace napkin
@@ -0,0 +1,147 @@
+#ifndef NAPKIN_RESOLVER_H_
+#define NAPKIN_RESOLVER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AST.h"
+#include "ASTVisitor.h"
+
+namespace napkin {
+
+/**
+ * Assigns every local variable a slot in the frame of its block or function
+ * and annotates each use of a name with the frame and slot it refers to (see
+ * Identifier).
+ *
+ * Names are resolved in source order, following napkin's scoping rules:
+ * - ':=' declares a variable in the innermost block
+ * - '=' assigns to the innermost visible variable of that name, or declares a
+ *   new one in the innermost block if there is none
+ * - names declared at the top level are globals, which are looked up by name
+ *
+ * A block only gets a frame if it declares a name. Other blocks run in the
+ * enclosing frame.
+ *
+ * A name declared in an enclosing function is a free variable of the lambdas
+ * in between: each of them captures it (see LambdaExpr::captures) into a
+ * slot of its call frame, and inside the lambda the name refers to that
+ * slot. Captured variables are boxed, so the variable and every capture of
+ * it share one Cell.
+ *
+ * Calls whose value is the value of the lambda they are in (the last
+ * statement of the body, or returned) are marked as tail calls.
+ *
+ * The resolver remembers the globals declared so far, so a repl can resolve
+ * each line with the same resolver.
+ */
+class Resolver : public ASTVisitor<void> {
+public:
+  // Names already bound in the global environment (e.g. native functions)
+  Resolver(std::vector<std::string> globalNames);
+
+  void resolve(std::vector<Stmt *> stmts);
+
+  virtual void visitStmt(Stmt *stmt);
+  virtual void visitExprStmt(ExprStmt *stmt);
+  virtual void visitOutputStmt(OutputStmt *stmt);
+  virtual void visitBlockStmt(BlockStmt *stmt);
+  virtual void visitIfStmt(IfStmt *stmt);
+  virtual void visitWhileStmt(WhileStmt *stmt);
+  virtual void visitReturnStmt(ReturnStmt *stmt);
+  virtual void visitExpr(Expr *expr);
+  virtual void visitLambdaExpr(LambdaExpr *expr);
+  virtual void visitVarDeclExpr(VarDeclExpr *expr);
+  virtual void visitAssignExpr(AssignExpr *expr);
+  virtual void visitBinaryExpr(BinaryExpr *expr);
+  virtual void visitGrouping(Grouping *expr);
+  virtual void visitUnaryExpr(UnaryExpr *expr);
+  virtual void visitCallExpr(CallExpr *expr);
+  virtual void visitIdentifier(Identifier *expr);
+  virtual void visitRealNumber(RealNumber *expr);
+  virtual void visitImaginaryNumber(ImaginaryNumber *expr);
+  virtual void visitString(String *expr);
+  virtual void visitBoolean(Boolean *expr);
+  virtual void visitKeywordConstant(KeywordConstant *expr);
+
+private:
+  /**
+   * A block or function body. The top level is the scope with no parent.
+   */
+  struct Scope {
+    Scope *parent;
+    // Slot of each name declared so far
+    std::unordered_map<std::string, unsigned long> slots;
+    // Slot of each free variable captured so far (function bodies only)
+    std::unordered_map<std::string, unsigned long> captures;
+    // True for each slot holding a Cell
+    std::vector<bool> boxed;
+    // The lambda of a function body, nullptr for blocks
+    LambdaExpr *lambda;
+
+    bool hasFrame() { return lambda != nullptr || !boxed.empty(); }
+    unsigned long newSlot();
+  };
+
+  /**
+   * A use of a name whose depth is only known once every scope it crosses is
+   * known to have a frame or not, and whether it is boxed once every lambda
+   * that may capture it has been resolved.
+   */
+  struct Reference {
+    unsigned long *depth;
+    bool *boxed;
+    Scope *from;
+    Scope *to; // nullptr for globals
+    unsigned long slot;
+  };
+
+  /**
+   * The address of a capture, made once the lambda's captures stop growing.
+   */
+  struct CaptureReference {
+    LambdaExpr *lambda;
+    unsigned long capture;
+    Scope *from;
+    Scope *to;
+  };
+
+  void visitStmts(std::vector<Stmt *> &stmts);
+  // Function bodies pass their lambda
+  Scope *pushScope(LambdaExpr *lambda);
+  void popScope();
+  // Looks for a local variable, returns the scope declaring it or nullptr
+  Scope *findLocal(std::string name);
+  // Returns the scope whose frame holds the variable a name refers to from a
+  // scope, capturing it if needed, or nullptr for globals
+  Scope *lookup(Scope *from, const std::string &name, unsigned long &slot);
+  void address(std::string name, unsigned long *depth, long *slot,
+               bool *boxed);
+  void declare(std::string name, unsigned long *depth, long *slot,
+               bool *boxed);
+  unsigned long countFrames(Scope *from, Scope *to);
+
+  // True while visiting a statement or expression whose value is the value of
+  // the innermost lambda
+  bool tail;
+  bool inFunction;
+
+  // Top level names
+  std::unordered_set<std::string> globals;
+
+  // Scopes of the statements being resolved (the innermost one is current)
+  std::vector<std::unique_ptr<Scope>> scopes;
+  Scope *current;
+
+  std::vector<Reference> references;
+  std::vector<CaptureReference> captureReferences;
+  // Blocks waiting to learn whether they need a frame
+  std::vector<std::pair<BlockStmt *, Scope *>> blocks;
+};
+
+} // namespace napkin
+
+#endif
@@ -190,7 +190,7 @@ std::string Token::tokenTypeAsString() {
   return napkin::tokenTypeAsString(this->tokenType);
 }
 
-std::string Token::getLexeme() {
+const std::string &Token::getLexeme() {
   return lexeme;
 }
 
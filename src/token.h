@@ -118,7 +118,7 @@ public:
   std::string tokenTypeAsString();
   unsigned int getLine();
   unsigned int getColumn();
-  std::string getLexeme();
+  const std::string &getLexeme();
 
 private:
   TokenType tokenType;
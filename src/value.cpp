@@ -0,0 +1,46 @@
+#include "value.h"
+
+#include "heap.h"
+#include "nobject.h"
+
+namespace napkin {
+
+/**
+ * Returns the napkin type of a value.
+ */
+NType Value::getType() const {
+  if (isNumber()) {
+    return N_REAL_NUMBER;
+  }
+  if (isBoolean()) {
+    return N_BOOLEAN;
+  }
+  if (isObject()) {
+    return asObject()->getType();
+  }
+  return N_NULL;
+}
+
+/**
+ * Returns the string representation of a value.
+ */
+std::string Value::repr() const {
+  if (isNumber()) {
+    return std::to_string(asNumber());
+  }
+  if (isBoolean()) {
+    return (asBoolean() ? "true" : "false");
+  }
+  if (isObject()) {
+    return asObject()->repr();
+  }
+  return "nil";
+}
+
+void markValue(Heap *heap, Value value) {
+  if (value.isObject()) {
+    heap->mark(value.asObject());
+  }
+}
+
+} // namespace napkin
@@ -0,0 +1,113 @@
+#ifndef NAPKIN_VALUE_H_
+#define NAPKIN_VALUE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * Compact representation of napkin values.
+ */
+
+namespace napkin {
+
+class NObject;
+class Heap;
+
+/**
+ * All possible types of objects in the napkin language.
+ */
+enum NType {
+  N_REAL_NUMBER,
+  N_COMPLEX_NUMBER,
+  N_BOOLEAN,
+  N_STRING,
+  N_CALLABLE,
+  N_NULL,
+};
+
+/**
+ * A napkin value packed into a single 64 bit word using NaN-boxing.
+ *
+ * Real numbers are stored as plain doubles. Every other value hides inside the
+ * unused bits of a quiet NaN:
+ * - null, true, false and undefined are small tags in the low bits
+ * - heap objects (strings, complex numbers, callables) set the sign bit and
+ *   store the pointer in the low 48 bits
+ *
+ * "undefined" is never visible to napkin code. It marks a name with no binding.
+ */
+class Value {
+public:
+  Value() : bits(QNAN | TAG_NULL) {}
+  explicit Value(double number) {
+    std::memcpy(&bits, &number, sizeof(double));
+    // NaNs produced by arithmetic are canonicalized so they can't be mistaken
+    // for a boxed value. The sign is kept, since it shows when printed.
+    if (number != number) {
+      bits = CANONICAL_NAN | (bits & SIGN_BIT);
+    }
+  }
+  explicit Value(NObject *object)
+      : bits(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)object) {}
+  // Booleans must be built with Value::boolean
+  Value(bool value) = delete;
+
+  static Value boolean(bool value) {
+    return fromBits(QNAN | (value ? TAG_TRUE : TAG_FALSE));
+  }
+  static Value null() { return fromBits(QNAN | TAG_NULL); }
+  static Value undefined() { return fromBits(QNAN | TAG_UNDEFINED); }
+
+  bool isNumber() const { return (bits & QNAN) != QNAN; }
+  bool isBoolean() const { return (bits | 1) == (QNAN | TAG_TRUE); }
+  bool isNull() const { return bits == (QNAN | TAG_NULL); }
+  bool isUndefined() const { return bits == (QNAN | TAG_UNDEFINED); }
+  bool isObject() const {
+    return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+  }
+
+  double asNumber() const {
+    double number;
+    std::memcpy(&number, &bits, sizeof(double));
+    return number;
+  }
+  bool asBoolean() const { return bits == (QNAN | TAG_TRUE); }
+  NObject *asObject() const {
+    return (NObject *)(uintptr_t)(bits & ~(SIGN_BIT | QNAN));
+  }
+
+  // Two values are identical if they have the same bit pattern
+  bool operator==(const Value &other) const { return bits == other.bits; }
+  bool operator!=(const Value &other) const { return bits != other.bits; }
+
+  NType getType() const;
+  // Like python's __repr__()
+  std::string repr() const;
+
+private:
+  static const uint64_t SIGN_BIT = 0x8000000000000000;
+  static const uint64_t QNAN = 0x7ffc000000000000;
+  static const uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+  // Tags for values that aren't numbers or objects
+  static const uint64_t TAG_UNDEFINED = 0;
+  static const uint64_t TAG_NULL = 1;
+  static const uint64_t TAG_FALSE = 2;
+  static const uint64_t TAG_TRUE = 3;
+
+  static Value fromBits(uint64_t bits) {
+    Value value;
+    value.bits = bits;
+    return value;
+  }
+
+  uint64_t bits;
+};
+
+// Marks the object a value points to (if any) as reachable
+void markValue(Heap *heap, Value value);
+
+} // namespace napkin
+
+#endif
@@ -0,0 +1,520 @@
+#include "vm.h"
+
+#include <functional>
+#include <iostream>
+
+namespace napkin {
+
+VM::VM() : stack(INITIAL_STACK_SIZE) {
+  globals = new Environment;
+  defineNativeFunctions(globals);
+  environment = globals;
+  top = stack.data();
+  maxDepth = DEFAULT_MAX_DEPTH;
+  heap()->addRootSource(this);
+}
+
+VM::~VM() {
+  heap()->removeRootSource(this);
+}
+
+/**
+ * Runs the top level of a script.
+ */
+void VM::run(CompiledFunction *script) {
+  reserveStack(script->maxStack);
+  CallFrame frame;
+  frame.function = script;
+  frame.ip = script->code.data();
+  frame.base = top;
+  frame.environment = nullptr;
+  frame.callerEnvironment = environment;
+  frame.root = globals;
+  frames.push_back(frame);
+  try {
+    execute();
+  } catch (...) {
+    unwind();
+    throw;
+  }
+  frames.pop_back();
+}
+
+static inline unsigned long readShort(const uint8_t *ip) {
+  return (ip[0] << 8) | ip[1];
+}
+
+static inline Value toValue(double number) { return Value(number); }
+static inline Value toValue(bool boolean) { return Value::boolean(boolean); }
+
+/**
+ * Replaces the two operands on top of the stack with the result of a binary
+ * operator instruction, and moves past its operands. Two real numbers are
+ * operated on in place with Operation, everything else goes through the
+ * operator functions.
+ */
+template <typename Operation>
+inline void VM::binaryOperator(OpCode op, const uint8_t *&ip,
+                               CallFrame *frame) {
+  if (top[-2].isNumber() && top[-1].isNumber()) {
+    top[-2] = toValue(Operation()(top[-2].asNumber(), top[-1].asNumber()));
+  } else {
+    top[-2] = operate(op, ip[0], frame->function->sites[readShort(ip + 1)],
+                      top[-2], top[-1]);
+  }
+  top--;
+  ip += 3;
+}
+
+/**
+ * Executes instructions until the script halts.
+ */
+void VM::execute() {
+  CallFrame *frame = &frames.back();
+  const uint8_t *ip = frame->ip;
+  while (true) {
+    OpCode op = (OpCode)*ip++;
+    switch (op) {
+    case OP_CONSTANT:
+      *top++ = frame->function->constants[readShort(ip)];
+      ip += 2;
+      break;
+    case OP_NIL:
+      *top++ = Value();
+      break;
+    case OP_POP:
+      top--;
+      break;
+
+    case OP_GET_LOCAL: {
+      Value value = environment->ancestor(readShort(ip))
+                        ->getSlot(readShort(ip + 2));
+      // Names bound to nil are treated as undefined
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               frame->function->names[readShort(ip + 4)] +
+                               "'.");
+      }
+      *top++ = value;
+      ip += 6;
+      break;
+    }
+    case OP_SET_LOCAL:
+      environment->ancestor(readShort(ip))->setSlot(readShort(ip + 2),
+                                                    top[-1]);
+      ip += 4;
+      break;
+    case OP_DECLARE_LOCAL:
+      environment->ancestor(readShort(ip))
+          ->declareSlot(readShort(ip + 2),
+                        frame->function->names[readShort(ip + 4)], top[-1]);
+      ip += 6;
+      break;
+    case OP_GET_BOXED: {
+      Value value = environment->ancestor(readShort(ip))
+                        ->getBoxed(readShort(ip + 2));
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" +
+                               frame->function->names[readShort(ip + 4)] +
+                               "'.");
+      }
+      *top++ = value;
+      ip += 6;
+      break;
+    }
+    case OP_SET_BOXED:
+      environment->ancestor(readShort(ip))->setBoxed(readShort(ip + 2),
+                                                     top[-1]);
+      ip += 4;
+      break;
+    case OP_DECLARE_BOXED:
+      environment->ancestor(readShort(ip))
+          ->declareBoxed(readShort(ip + 2),
+                         frame->function->names[readShort(ip + 4)], top[-1]);
+      ip += 6;
+      break;
+    case OP_GET_GLOBAL: {
+      GlobalCache *cache = &frame->function->globals[readShort(ip)];
+      Value *binding = frame->root->find(cache);
+      Value value = binding != nullptr ? *binding : Value::undefined();
+      if (value.isUndefined() || value.isNull()) {
+        throw RuntimeException("undefined variable '" + cache->name + "'.");
+      }
+      *top++ = value;
+      ip += 2;
+      break;
+    }
+    case OP_SET_GLOBAL: {
+      GlobalCache *cache = &frame->function->globals[readShort(ip)];
+      Value *binding = frame->root->find(cache);
+      if (binding != nullptr) {
+        *binding = top[-1];
+      } else {
+        frame->root->bind(cache->name, top[-1]);
+      }
+      ip += 2;
+      break;
+    }
+    case OP_DECLARE_GLOBAL:
+      frame->root->declareVar(frame->function->names[readShort(ip)], top[-1]);
+      ip += 2;
+      break;
+
+    // Operators with a fast path for two real numbers (see binaryOperator)
+    case OP_ADD:
+      binaryOperator<std::plus<double>>(op, ip, frame);
+      break;
+    case OP_SUBTRACT:
+      binaryOperator<std::minus<double>>(op, ip, frame);
+      break;
+    case OP_MULTIPLY:
+      binaryOperator<std::multiplies<double>>(op, ip, frame);
+      break;
+    case OP_DIVIDE:
+      binaryOperator<std::divides<double>>(op, ip, frame);
+      break;
+    case OP_EQUAL:
+      binaryOperator<std::equal_to<double>>(op, ip, frame);
+      break;
+    case OP_NOT_EQUAL:
+      binaryOperator<std::not_equal_to<double>>(op, ip, frame);
+      break;
+    case OP_LESS:
+      binaryOperator<std::less<double>>(op, ip, frame);
+      break;
+    case OP_LESS_EQUAL:
+      binaryOperator<std::less_equal<double>>(op, ip, frame);
+      break;
+    case OP_GREATER:
+      binaryOperator<std::greater<double>>(op, ip, frame);
+      break;
+    case OP_GREATER_EQUAL:
+      binaryOperator<std::greater_equal<double>>(op, ip, frame);
+      break;
+    // Everything else goes through the operator functions
+    case OP_POWER:
+    case OP_OR:
+    case OP_AND:
+      top[-2] = operate(op, ip[0], frame->function->sites[readShort(ip + 1)],
+                        top[-2], top[-1]);
+      top--;
+      ip += 3;
+      break;
+    case OP_NEGATE:
+    case OP_J:
+    case OP_NOT:
+      top[-1] = operate(op, ip[0], frame->function->sites[readShort(ip + 1)],
+                        Value(), top[-1]);
+      ip += 3;
+      break;
+
+    case OP_JUMP:
+      ip += 2 + readShort(ip);
+      break;
+    case OP_JUMP_IF_FALSE:
+      top--;
+      if (top->isBoolean() ? top->asBoolean() : isTruthy(*top)) {
+        ip += 2;
+      } else {
+        ip += 2 + readShort(ip);
+      }
+      break;
+    case OP_LOOP:
+      ip += 2 - readShort(ip);
+      // Loop back edges and calls are the VM's safe points, and its steps
+      safepoint();
+      break;
+
+    case OP_PUSH_FRAME:
+      environment = acquireFrame(environment, readShort(ip));
+      ip += 2;
+      break;
+    case OP_POP_FRAME: {
+      Environment *block = environment;
+      environment = block->ancestor(1);
+      releaseFrame(block);
+      break;
+    }
+
+    case OP_CLOSURE: {
+      AllocationSite site(frame->function->sites[readShort(ip + 2)]);
+      *top++ = Value(new NClosure(
+          frame->function->functions[readShort(ip)]->lambda, environment));
+      ip += 4;
+      break;
+    }
+    case OP_CALL:
+    case OP_TAIL_CALL:
+      frame->ip = ip + 3;
+      call(ip[0], frame->function->sites[readShort(ip + 1)],
+           op == OP_TAIL_CALL);
+      // Pushing the frame may have moved the others
+      frame = &frames.back();
+      ip = frame->ip;
+      break;
+    case OP_RETURN: {
+      Value result = top[-1];
+      if (frames.size() == 1) {
+        // Returning from the script itself
+        throw ReturnException(result);
+      }
+      releaseFrame(frame->environment);
+      environment = frame->callerEnvironment;
+      if (frame->function->usesRegion) {
+        heap()->leaveRegion(frame->mark);
+      }
+      top = frame->base;
+      *top++ = result;
+      frames.pop_back();
+      frame = &frames.back();
+      ip = frame->ip;
+      break;
+    }
+
+    case OP_OUTPUT:
+      if (!top[-1].isNull()) {
+        // Output the string representation of result
+        std::cout << top[-1].repr() << std::endl;
+      } else {
+        std::cout << "nil" << std::endl;
+      }
+      top[-1] = Value();
+      break;
+    case OP_HALT:
+      return;
+    }
+  }
+}
+
+Value VM::operate(OpCode op, uint8_t flags, Token &site, Value left,
+                  Value right) {
+  // Results that can't escape the current call go into its region
+  RegionAllocation allocation((flags & OPERATOR_CONTAINED) != 0);
+  AllocationSite allocationSite(site);
+  switch (op) {
+  case OP_ADD:
+    return nAdd(left, right);
+  case OP_SUBTRACT:
+    return nSubtract(left, right);
+  case OP_MULTIPLY:
+    return nMultiply(left, right);
+  case OP_DIVIDE:
+    return nDivide(left, right);
+  case OP_POWER:
+    return nPower(left, right);
+  case OP_EQUAL:
+    return nLogicalEqual(left, right);
+  case OP_NOT_EQUAL:
+    return nLogicalNotEqual(left, right);
+  case OP_OR:
+    return nLogicalOr(left, right);
+  case OP_AND:
+    return nLogicalAnd(left, right);
+  case OP_LESS:
+    return nLess(left, right);
+  case OP_LESS_EQUAL:
+    return nLessEqual(left, right);
+  case OP_GREATER:
+    return nGreater(left, right);
+  case OP_GREATER_EQUAL:
+    return nGreaterEqual(left, right);
+  case OP_NEGATE:
+    return nNegate(right);
+  case OP_J:
+    return nJ(right);
+  case OP_NOT:
+    return nNot(right);
+  default:
+    // should be unreachable if the compiler is set up correctly
+    throw ImplementationException("operator not handled in VM.");
+  }
+}
+
+/**
+ * Calls the callable below the arguments on top of the stack. Closures get a
+ * new CallFrame, native functions are called right away.
+ * A tail call to a closure first returns from the calling function, moving
+ * the callee and the arguments down to where its result would go. Results
+ * in the caller's region don't escape, so neither the callee nor the
+ * arguments can be in it.
+ */
+void VM::call(unsigned long argumentCount, Token &site, bool tail) {
+  safepoint();
+  Value *arguments = top - argumentCount;
+  Value callee = arguments[-1];
+  if (!(callee.getType() == N_CALLABLE)) {
+    throw RuntimeException("object not callable.");
+  }
+  NCallable *function = (NCallable *)callee.asObject();
+  if (argumentCount != (unsigned long)function->arity()) {
+    throw RuntimeException("expected " + std::to_string(function->arity()) +
+                           " arguments but got " +
+                           std::to_string(argumentCount) + ".");
+  }
+
+  AllocationSite allocationSite(site);
+  NClosure *closure = function->asClosure();
+  if (closure == nullptr) {
+    // Native functions don't need an interpreter
+    Value result =
+        function->call(nullptr, Arguments(arguments, argumentCount));
+    top = arguments - 1;
+    *top++ = result;
+    return;
+  }
+
+  if (tail && frames.size() > 1) {
+    CallFrame &caller = frames.back();
+    releaseFrame(caller.environment);
+    environment = caller.callerEnvironment;
+    if (caller.function->usesRegion) {
+      heap()->leaveRegion(caller.mark);
+    }
+    Value *base = caller.base;
+    for (Value *value = arguments - 1; value < top; value++) {
+      *base++ = *value;
+    }
+    top = base;
+    arguments = top - argumentCount;
+    frames.pop_back();
+  }
+
+  CompiledFunction *compiled = closure->getExpr()->function;
+  if (frames.size() >= maxDepth) {
+    throw RuntimeException("stack overflow: more than " +
+                           std::to_string(maxDepth) + " nested calls.");
+  }
+  reserveStack(compiled->maxStack);
+  arguments = top - argumentCount;
+  CallFrame frame;
+  frame.function = compiled;
+  frame.ip = compiled->code.data();
+  frame.base = arguments - 1;
+  // Temporaries that can't escape the call are freed when it returns
+  if (compiled->usesRegion) {
+    frame.mark = heap()->enterRegion();
+  }
+  frame.environment = acquireFrame(closure->getGlobals(), compiled->slotCount);
+  closure->bindCaptures(frame.environment);
+  frame.callerEnvironment = environment;
+  frame.root = closure->getGlobals();
+  frames.push_back(frame);
+
+  // Match parameters with arguments
+  for (unsigned long i = 0; i < argumentCount; i++) {
+    if (compiled->parameterBoxed[i]) {
+      frame.environment->declareBoxed(compiled->parameterSlots[i],
+                                      compiled->parameterNames[i],
+                                      arguments[i]);
+    } else {
+      frame.environment->declareSlot(compiled->parameterSlots[i],
+                                     compiled->parameterNames[i],
+                                     arguments[i]);
+    }
+  }
+  environment = frame.environment;
+  // The callee stays on the stack for the duration of the call
+  top = arguments;
+}
+
+/**
+ * The stack doubles in size, so a deep recursion only moves it a few times.
+ */
+void VM::reserveStack(unsigned long count) {
+  unsigned long used = top - stack.data();
+  if (used + count <= stack.size()) {
+    return;
+  }
+  std::vector<unsigned long> bases(frames.size());
+  for (unsigned long i = 0; i < frames.size(); i++) {
+    bases[i] = frames[i].base - stack.data();
+  }
+  unsigned long size = stack.size();
+  while (used + count > size) {
+    size *= 2;
+  }
+  stack.resize(size);
+  top = stack.data() + used;
+  for (unsigned long i = 0; i < frames.size(); i++) {
+    frames[i].base = stack.data() + bases[i];
+  }
+}
+
+/**
+ * Runs a pending garbage collection and counts a step. Every live value is on
+ * the stack or in an environment at a safe point.
+ */
+void VM::safepoint() {
+  if (heap()->collectionRequested()) {
+    heap()->collect();
+  }
+  if (heap()->getProfiler() != nullptr) {
+    heap()->getProfiler()->poll();
+  }
+  budget.step();
+}
+
+void VM::unwind() {
+  while (frames.size() > 1) {
+    if (frames.back().function->usesRegion) {
+      heap()->leaveRegion(frames.back().mark);
+    }
+    frames.pop_back();
+  }
+  frames.clear();
+  environment = globals;
+  top = stack.data();
+}
+
+/**
+ * Marks the values on the stack and every environment in use.
+ */
+void VM::markRoots(Heap *heap) {
+  heap->mark(globals);
+  heap->mark(environment);
+  for (Value *value = stack.data(); value < top; value++) {
+    markValue(heap, *value);
+  }
+  for (unsigned long i = 0; i < frames.size(); i++) {
+    heap->mark(frames[i].environment);
+    heap->mark(frames[i].callerEnvironment);
+  }
+  for (unsigned long i = 0; i < framePool.size(); i++) {
+    heap->mark(framePool[i]);
+  }
+}
+
+/**
+ * Returns an empty environment for a block or call, reusing a recycled one if
+ * possible.
+ */
+Environment *VM::acquireFrame(Environment *enclosing,
+                              unsigned long slotCount) {
+  if (framePool.empty()) {
+    return new Environment(enclosing, slotCount);
+  }
+  Environment *frame = framePool.back();
+  framePool.pop_back();
+  frame->reset(enclosing, slotCount);
+  return frame;
+}
+
+/**
+ * Called when the block or call that acquired a frame is done with it. Nothing
+ * refers to the frame anymore: closures only keep the cells of its captured
+ * variables.
+ */
+void VM::releaseFrame(Environment *frame) {
+  if (framePool.size() >= MAX_POOLED_FRAMES) {
+    return;
+  }
+  // Drop the frame's references right away so they can be collected
+  frame->reset(nullptr, 0);
+  framePool.push_back(frame);
+}
+
+std::vector<std::string> VM::getGlobalNames() {
+  return globals->getNames();
+}
+
+} // namespace napkin
@@ -0,0 +1,112 @@
+#ifndef NAPKIN_VM_H_
+#define NAPKIN_VM_H_
+
+#include <string>
+#include <vector>
+
+#include "budget.h"
+#include "bytecode.h"
+#include "environment.h"
+#include "heap.h"
+#include "nativefunction.h"
+#include "nclosure.h"
+#include "nexception.h"
+#include "noperator.h"
+#include "profiler.h"
+#include "value.h"
+
+namespace napkin {
+
+/**
+ * Stack based virtual machine that runs the bytecode made by the Compiler.
+ * An alternative to the Interpreter that produces the same results: variables
+ * live in the same environments (frames of slots), closures are the same
+ * NClosure objects and operators are the same functions. What it saves is the
+ * work around them: there is no double dispatch per node, temporaries and
+ * arguments stay on the value stack, and returning doesn't throw.
+ *
+ * Napkin calls don't recurse on the C++ stack: each one pushes a CallFrame,
+ * and calls in tail position replace the caller's. The value stack and the
+ * call frames grow on the heap as needed, so recursion is only bounded by the
+ * maximum depth (see setMaxDepth), past which a RuntimeException is thrown.
+ */
+class VM : public RootSource {
+public:
+  VM();
+  ~VM();
+
+  void run(CompiledFunction *script);
+
+  // Names the Resolver must treat as globals
+  std::vector<std::string> getGlobalNames();
+
+  virtual void markRoots(Heap *heap);
+
+  // Number of nested calls allowed
+  void setMaxDepth(unsigned long t_maxDepth) { maxDepth = t_maxDepth; }
+
+  // Steps executed so far (loop iterations and calls), and the limits on them
+  ExecutionBudget &getBudget() { return budget; }
+
+  static const unsigned long DEFAULT_MAX_DEPTH = 1 << 20;
+  static const unsigned long INITIAL_STACK_SIZE = 1 << 12;
+
+private:
+  /**
+   * State of a function being executed.
+   */
+  struct CallFrame {
+    CompiledFunction *function;
+    // Next instruction to execute once a call made by this function returns
+    const uint8_t *ip;
+    // Stack slot of the callee, where the result of the call goes
+    Value *base;
+    // Frame of the call (nullptr for the script)
+    Environment *environment;
+    // Environment to go back to when the call returns
+    Environment *callerEnvironment;
+    // Global environment of the function (see Environment::root)
+    Environment *root;
+    // Region opened by the call
+    Region::Mark mark;
+  };
+
+  void execute();
+  // Runs the operator of a binary or unary instruction that has no fast path
+  Value operate(OpCode op, uint8_t flags, Token &site, Value left,
+                Value right);
+  // Runs a binary operator instruction whose operands are on top of the stack
+  template <typename Operation>
+  void binaryOperator(OpCode op, const uint8_t *&ip, CallFrame *frame);
+  void call(unsigned long argumentCount, Token &site, bool tail);
+  // Makes room for count more values above the top of the stack, moving the
+  // stack if needed
+  void reserveStack(unsigned long count);
+  void safepoint();
+  // Closes the regions of every call that was interrupted by an exception
+  void unwind();
+
+  Environment *acquireFrame(Environment *enclosing, unsigned long slotCount);
+  void releaseFrame(Environment *frame);
+
+  Environment *globals;
+  // Current scope
+  Environment *environment;
+
+  std::vector<Value> stack;
+  // One past the top value of the stack
+  Value *top;
+
+  std::vector<CallFrame> frames;
+  unsigned long maxDepth;
+
+  ExecutionBudget budget;
+
+  // Released frames that are ready to be reused
+  std::vector<Environment *> framePool;
+  static const unsigned long MAX_POOLED_FRAMES = 64;
+};
+
+} // namespace napkin
+
+#endif